@@ -0,0 +1,185 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   AtomicRangeMap.h
+// Desc:   Lock-free publishing of RangeMap snapshots to concurrent readers
+//================================================================================
+#ifndef ATOMIC_RANGE_MAP_H
+#define ATOMIC_RANGE_MAP_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "RangeMap.h"
+
+/* Holds the current version of a RangeMap for many reader threads while a writer
+ * builds new versions off to the side and swaps them in atomically. Readers never
+ * block or take locks: each registers a Reader once and pins the current version
+ * with two atomic stores and an atomic load. Old versions are freed with epoch-based
+ * reclamation once no reader can still be using them.
+ *
+ * Readers take slots from blocks of BLOCK_READERS. When every slot is in use a
+ * new Reader chains on another block, so any number of readers can register;
+ * blocks are kept until the map is destroyed and each one adds to the scan a
+ * writer makes when freeing old versions. */
+template <typename T, typename I = size_t>
+class AtomicRangeMap {
+public:
+    static constexpr size_t BLOCK_READERS = 256;    // Reader slots added at a time
+
+private:
+    // Per-reader state on its own cache line
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> Epoch{0};     // Epoch at which the reader pinned a version; 0 if not pinned
+        std::atomic<bool> Used{false};      // Whether a Reader owns this slot
+    };
+
+    // A block of reader slots; blocks are only added, never removed, while the map exists
+    struct Block {
+        Slot Slots[BLOCK_READERS];
+        std::atomic<Block*> Next{nullptr};  // The block chained on once this one filled up
+    };
+
+    // A replaced version waiting to be freed
+    struct Retired {
+        const RangeMap<T, I>* Map;
+        uint64_t Epoch;     // Readers pinned at this epoch or earlier may still use Map
+    };
+
+    Block Head;                                 // First block of reader slots
+    std::atomic<const RangeMap<T, I>*> Cur;     // Current version
+    std::atomic<uint64_t> Global{1};            // Current epoch
+    std::vector<Retired> Garbage;               // Replaced versions not yet freed
+    std::mutex WMtx;                            // Serializes writers
+
+    // Frees replaced versions that no pinned reader can be using; requires WMtx
+    void Reclaim() {
+        uint64_t Min = std::numeric_limits<uint64_t>::max();    // Oldest pinned epoch
+        for (const Block* b = &Head; b != nullptr; b = b->Next.load()) {
+            for (const Slot& s : b->Slots) {
+                const uint64_t e = s.Epoch.load();
+                if (e != 0 && e < Min)
+                    Min = e;
+            }
+        }
+        auto It = std::remove_if(Garbage.begin(), Garbage.end(), [Min](const Retired& r) {
+            if (r.Epoch >= Min)
+                return false;
+            delete r.Map;
+            return true;
+        });
+        Garbage.erase(It, Garbage.end());
+    }
+
+public:
+    AtomicRangeMap() : Cur(new RangeMap<T, I>()) { }
+
+    AtomicRangeMap(const AtomicRangeMap&) = delete;
+    AtomicRangeMap& operator=(const AtomicRangeMap&) = delete;
+
+    // All readers must have been destroyed
+    ~AtomicRangeMap() {
+        for (const Retired& r : Garbage)
+            delete r.Map;
+        delete Cur.load();
+        for (Block* b = Head.Next.load(); b != nullptr; ) {
+            Block* n = b->Next.load();
+            delete b;
+            b = n;
+        }
+    }
+
+    /* Makes a new version visible to readers. The previous version is freed once
+     * every reader that might be using it has unpinned it.
+     * M:   The new version */
+    void Publish(std::unique_ptr<RangeMap<T, I> > M) {
+        std::lock_guard<std::mutex> Lock(WMtx);
+        const RangeMap<T, I>* Old = Cur.exchange(M.release());
+        // Readers pinning after this increment are guaranteed to see the new version
+        Garbage.push_back(Retired{Old, Global.fetch_add(1)});
+        Reclaim();
+    }
+
+    /* Builds a new version from a list of intervals like [a, b) and publishes it
+     * S:       An array of interval starting values
+     * E:       An array of interval closing values
+     * N:       The number of elements in S and E
+     * Return:  False if I cannot hold N - 1; the current version is then kept */
+    bool Build(const T* S, const T* E, const size_t N) {
+        std::unique_ptr<RangeMap<T, I> > M(new RangeMap<T, I>());
+        if (!M->Build(S, E, N))
+            return false;
+        Publish(std::move(M));
+        return true;
+    }
+
+    // Frees any replaced versions no longer in use
+    void Collect() {
+        std::lock_guard<std::mutex> Lock(WMtx);
+        Reclaim();
+    }
+
+    /* A reader thread's registration. Each thread reading the map creates one
+     * Reader and pins a version while it uses it. A Reader must not be shared
+     * between threads or pinned twice at once. */
+    class Reader {
+        AtomicRangeMap* Owner;
+        Slot* S = nullptr;
+
+    public:
+        explicit Reader(AtomicRangeMap& A) : Owner(&A) {
+            for (Block* b = &A.Head; ; ) {
+                for (Slot& s : b->Slots) {
+                    bool Expected = false;
+                    if (s.Used.compare_exchange_strong(Expected, true)) {
+                        S = &s;
+                        break;
+                    }
+                }
+                if (S != nullptr)
+                    break;
+                // Every slot of this block is taken; move on, chaining a new block if there is none
+                Block* n = b->Next.load();
+                if (n == nullptr) {
+                    std::unique_ptr<Block> New(new Block);
+                    if (b->Next.compare_exchange_strong(n, New.get()))
+                        n = New.release();  // Otherwise n is the block another reader chained on
+                }
+                b = n;
+            }
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        ~Reader() {
+            S->Epoch.store(0);
+            S->Used.store(false);
+        }
+
+        // Keeps a version alive while in scope
+        class Pin {
+            Slot* S;
+            const RangeMap<T, I>* M;
+
+        public:
+            Pin(Slot* S, const RangeMap<T, I>* M) : S(S), M(M) { }
+            Pin(const Pin&) = delete;
+            Pin& operator=(const Pin&) = delete;
+            ~Pin() { S->Epoch.store(0, std::memory_order_release); }
+
+            const RangeMap<T, I>& operator*() const { return *M; }
+            const RangeMap<T, I>* operator->() const { return M; }
+        };
+
+        /* Pins the current version
+         * Return:  The pinned version; valid until the Pin is destroyed */
+        Pin Lock() {
+            // Announce the epoch before loading the version; a writer that does not
+            // see the announcement has already swapped in the version loaded here
+            S->Epoch.store(Owner->Global.load());
+            return Pin(S, Owner->Cur.load());
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,133 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   DeltaRangeMap.h
+// Desc:   Memory-optimal variant of RangeMap storing active set deltas
+//================================================================================
+#ifndef DELTA_RANGE_MAP_H
+#define DELTA_RANGE_MAP_H
+#include "RangeMap.h"
+
+/* Solves the same problem as RangeMap, but instead of storing the full
+ * active set at every breakpoint only the intervals opening and closing at
+ * each breakpoint are kept, along with occasional checkpoints of the full
+ * active set. Query reconstructs the result from the nearest checkpoint.
+ *
+ * A checkpoint is taken once the number of deltas since the previous one
+ * reaches the size of the active set (and at least Gap), so checkpoints never
+ * store more than the deltas they summarize. Memory is O(N) regardless of how
+ * intervals overlap, and a query costs O(k log k + Gap) for a result of size k. */
+template <typename T>
+class DeltaRangeMap {
+    std::vector<T> Tab;         // Internal table for searching intervals
+    std::vector<size_t> SS;     // Interval indices ordered by starting value
+    std::vector<size_t> SE;     // Interval indices ordered by closing value
+    std::vector<size_t> OPos;   // SS[OPos[x], OPos[x + 1]) open at breakpoint x
+    std::vector<size_t> CPos;   // SE[CPos[x], CPos[x + 1]) close at breakpoint x
+    std::vector<size_t> CkPos;  // Breakpoint index of each checkpoint
+    std::vector<size_t> CkOff;  // Offsets into CkIdx; one per checkpoint plus a terminator
+    std::vector<size_t> CkIdx;  // Concatenated active sets for all checkpoints
+    size_t Gap;                 // Minimum number of deltas between checkpoints
+
+public:
+    /* Gap: The minimum number of deltas between checkpoints; larger values
+     *      trade query time for memory */
+    explicit DeltaRangeMap(size_t Gap = 32) : Gap(Gap) { }
+
+    /* Builds the DeltaRangeMap from a list of intervals like [a, b)
+     * S:   An array of interval starting values
+     * E:   An array of interval closing values
+     * N:   The number of elements in S and E */
+    void Build(const T* S, const T* E, const size_t N) {
+        if (nullptr == S || nullptr == E || N == 0)
+            return;
+        Clear();
+        RMImpl::SortScratch<T> WS, WE;
+        RMImpl::ArgSort(S, E, N, SS, SE, 1, WS, WE);
+        const size_t NF = SS.size();    // Number of filtered values
+        Tab.reserve(NF * 2 + 2);        // 1 for each start/end + 2 for -inf and +inf
+        OPos.reserve(NF * 2 + 3);       // 1 for each above + 1 terminator
+        CPos.reserve(NF * 2 + 3);
+        PUSHBACK(OPos, 0);
+        PUSHBACK(CPos, 0);
+        CkOff.push_back(0);
+        std::vector<size_t> D;  // Intervals opened since the last checkpoint
+        std::vector<size_t> R;  // Intervals closed since the last checkpoint
+        size_t NA = 0;          // Size of active set
+        size_t ND = Gap;        // Deltas since the last checkpoint; forces one at the first breakpoint
+        RMImpl::Sweep(WS.V.data(), WE.V.data(), NF, [&](const T& v, size_t o1, size_t o2, size_t c1, size_t c2) {
+            D.insert(D.end(), SS.begin() + o1, SS.begin() + o2);
+            R.insert(R.end(), SE.begin() + c1, SE.begin() + c2);
+            NA += (o2 - o1);
+            NA -= (c2 - c1);
+            ND += (o2 - o1) + (c2 - c1);
+            if (ND >= std::max(Gap, NA)) {
+                // New checkpoint is the previous one with the pending deltas applied
+                std::sort(D.begin(), D.end());
+                std::sort(R.begin(), R.end());
+                const size_t c = CkOff.size() - 1;
+                CkIdx.resize(CkOff[c] + NA);
+                const size_t* W = RMImpl::MergeDelta(CkIdx.data() + CkOff[c - (c > 0)], CkIdx.data() + CkOff[c],
+                                                     D.data(), D.data() + D.size(), R.data(), R.data() + R.size(),
+                                                     CkIdx.data() + CkOff[c]);
+                assert(W == CkIdx.data() + CkIdx.size());
+                (void)W;
+                CkPos.push_back(Tab.size());
+                CkOff.push_back(CkIdx.size());
+                D.clear();
+                R.clear();
+                ND = 0;
+            }
+            PUSHBACK(Tab, v);
+            PUSHBACK(OPos, o2);
+            PUSHBACK(CPos, c2);
+        });
+    }
+
+    // Clears all elements from the range map
+    void Clear() {
+        Tab.clear();
+        SS.clear();
+        SE.clear();
+        OPos.clear();
+        CPos.clear();
+        CkPos.clear();
+        CkOff.clear();
+        CkIdx.clear();
+    }
+
+    /* Given a query point, finds all intervals containing the point
+     * p:       The query point
+     * Out:     Output; sorted indices of all intervals containing the point */
+    void Query(const T& p, std::vector<size_t>& Out) const {
+        Out.clear();
+        auto It = std::lower_bound(Tab.begin(), Tab.end(), p);
+        if (It == Tab.end())
+            return;
+        // Slot x holds the result, where x is the largest index such that Tab[x] <= p
+        const size_t x = (It - Tab.begin()) - (*It > p);
+        // Nearest checkpoint at or before x; the first breakpoint is always a checkpoint
+        const size_t c = (std::upper_bound(CkPos.begin(), CkPos.end(), x) - CkPos.begin()) - 1;
+        const size_t k = CkPos[c];
+        // Out = [checkpoint | opened since (sorted)] merged, followed by [closed since (sorted)]
+        Out.insert(Out.end(), CkIdx.begin() + CkOff[c], CkIdx.begin() + CkOff[c + 1]);
+        const size_t NC = Out.size();
+        Out.insert(Out.end(), SS.begin() + OPos[k + 1], SS.begin() + OPos[x + 1]);
+        const size_t NO = Out.size();
+        Out.insert(Out.end(), SE.begin() + CPos[k + 1], SE.begin() + CPos[x + 1]);
+        std::sort(Out.begin() + NC, Out.begin() + NO);
+        std::sort(Out.begin() + NO, Out.end());
+        std::inplace_merge(Out.begin(), Out.begin() + NC, Out.begin() + NO);
+        // Remove closed intervals in place; the write position never passes the read position
+        auto W = Out.begin();
+        auto R = Out.begin() + NO;
+        for (auto A = Out.begin(); A != Out.begin() + NO; ++A) {
+            if (R != Out.end() && *R == *A)
+                ++R;
+            else
+                *W++ = *A;
+        }
+        Out.resize(W - Out.begin());
+    }
+};
+
+#endif
@@ -0,0 +1,181 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   DynRangeMap.h
+// Desc:   Mutable variant of RangeMap supporting insertion and removal
+//================================================================================
+#ifndef DYN_RANGE_MAP_H
+#define DYN_RANGE_MAP_H
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+/* Solves the same problem as RangeMap for a set of intervals that changes over
+ * time. Intervals are kept in a treap ordered by starting value, where each node
+ * also stores the largest closing value in its subtree so subtrees that cannot
+ * contain a query point are skipped. Insert and Erase take O(log N) expected time
+ * and a query returning k intervals takes O(k log N). Intervals are identified by
+ * caller chosen ids; with ids 0 ... N - 1 queries give the same result as RangeMap. */
+template <typename T>
+class DynRangeMap {
+    static constexpr size_t NIL = std::numeric_limits<size_t>::max();
+
+    struct Node {
+        T A, B;         // The interval [A, B)
+        T MaxB;         // Largest closing value in this subtree
+        size_t Id;      // Caller chosen id of the interval
+        uint32_t Pri;   // Heap priority
+        size_t L, R;    // Children
+    };
+
+    std::vector<Node> Nodes;                    // Node pool; freed nodes are reused
+    std::vector<size_t> Free;                   // Unused entries of Nodes
+    std::unordered_map<size_t, size_t> ById;    // Node holding each id
+    std::minstd_rand Rng;                       // Priority generator
+    size_t Root = NIL;
+
+    // Whether node i orders before node j; by starting value then id
+    bool Less(size_t i, size_t j) const {
+        return (Nodes[i].A < Nodes[j].A) || (!(Nodes[j].A < Nodes[i].A) && (Nodes[i].Id < Nodes[j].Id));
+    }
+
+    // Recomputes the subtree maximum of node t
+    void Update(size_t t) {
+        Node& n = Nodes[t];
+        n.MaxB = n.B;
+        if (n.L != NIL && n.MaxB < Nodes[n.L].MaxB)
+            n.MaxB = Nodes[n.L].MaxB;
+        if (n.R != NIL && n.MaxB < Nodes[n.R].MaxB)
+            n.MaxB = Nodes[n.R].MaxB;
+    }
+
+    // Splits subtree t into nodes ordering before node k (L) and the rest (R)
+    void Split(size_t t, size_t k, size_t& L, size_t& R) {
+        if (t == NIL) {
+            L = R = NIL;
+            return;
+        }
+        if (Less(t, k)) {
+            Split(Nodes[t].R, k, Nodes[t].R, R);
+            L = t;
+        }
+        else {
+            Split(Nodes[t].L, k, L, Nodes[t].L);
+            R = t;
+        }
+        Update(t);
+    }
+
+    // Joins subtrees L and R where every node of L orders before every node of R
+    size_t Merge(size_t L, size_t R) {
+        if (L == NIL || R == NIL)
+            return (L == NIL) ? R : L;
+        if (Nodes[L].Pri > Nodes[R].Pri) {
+            Nodes[L].R = Merge(Nodes[L].R, R);
+            Update(L);
+            return L;
+        }
+        Nodes[R].L = Merge(L, Nodes[R].L);
+        Update(R);
+        return R;
+    }
+
+    // Removes node k from subtree t and returns the new subtree root
+    size_t Remove(size_t t, size_t k) {
+        if (t == k)
+            return Merge(Nodes[t].L, Nodes[t].R);
+        if (Less(k, t))
+            Nodes[t].L = Remove(Nodes[t].L, k);
+        else
+            Nodes[t].R = Remove(Nodes[t].R, k);
+        Update(t);
+        return t;
+    }
+
+    // Appends the ids of intervals in subtree t containing p to Out
+    void Stab(size_t t, const T& p, std::vector<size_t>& Out) const {
+        while (t != NIL && p < Nodes[t].MaxB) {
+            const Node& n = Nodes[t];
+            Stab(n.L, p, Out);
+            if (p < n.A)
+                return;     // All of the right subtree starts after p
+            if (p < n.B)
+                Out.push_back(n.Id);
+            t = n.R;
+        }
+    }
+
+public:
+    /* Inserts the interval [a, b); an existing interval with the same id is replaced
+     * a:   Interval starting value
+     * b:   Interval closing value
+     * Id:  Id of the interval */
+    void Insert(const T& a, const T& b, size_t Id) {
+        Erase(Id);
+        size_t k;
+        if (Free.empty()) {
+            k = Nodes.size();
+            Nodes.push_back(Node());
+        }
+        else {
+            k = Free.back();
+            Free.pop_back();
+        }
+        Nodes[k] = Node{a, b, b, Id, uint32_t(Rng()), NIL, NIL};
+        ById[Id] = k;
+        size_t L, R;
+        Split(Root, k, L, R);
+        Root = Merge(Merge(L, k), R);
+    }
+
+    /* Removes an interval
+     * Id:      Id of the interval
+     * Return:  True if the interval was present */
+    bool Erase(size_t Id) {
+        auto It = ById.find(Id);
+        if (It == ById.end())
+            return false;
+        Root = Remove(Root, It->second);
+        Free.push_back(It->second);
+        ById.erase(It);
+        return true;
+    }
+
+    /* Replaces the contents with a list of intervals like [a, b) with ids 0 ... N - 1
+     * S:   An array of interval starting values
+     * E:   An array of interval closing values
+     * N:   The number of elements in S and E */
+    void Build(const T* S, const T* E, const size_t N) {
+        Clear();
+        Nodes.reserve(N);
+        ById.reserve(N);
+        for (size_t i = 0; i < N; ++i)
+            Insert(S[i], E[i], i);
+    }
+
+    // Removes all intervals
+    void Clear() {
+        Nodes.clear();
+        Free.clear();
+        ById.clear();
+        Root = NIL;
+    }
+
+    // Number of intervals
+    size_t Size() const {
+        return ById.size();
+    }
+
+    /* Given a query point, finds all intervals containing the point
+     * p:       The query point
+     * Out:     Output; sorted ids of all intervals containing the point */
+    void Query(const T& p, std::vector<size_t>& Out) const {
+        Out.clear();
+        Stab(Root, p, Out);
+        std::sort(Out.begin(), Out.end());
+    }
+};
+
+#endif
@@ -0,0 +1,285 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   LogRangeMap.h
+// Desc:   Log-structured mutable RangeMap with background compaction
+//================================================================================
+#ifndef LOG_RANGE_MAP_H
+#define LOG_RANGE_MAP_H
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include "RangeMap.h"
+
+/* Mutable variant of RangeMap for write-heavy workloads. Intervals live in an
+ * immutable base RangeMap plus a list of small immutable runs, each a RangeMap
+ * over a batch of recent writes, plus a buffer of the newest writes. Every write
+ * is tagged with a sequence number and only the latest write of each id is live,
+ * so replaced and erased intervals are filtered out of query results rather than
+ * removed. An erase is logged as an empty interval, which acts as a tombstone.
+ * Once MaxRuns runs accumulate, a background thread merges the base and those
+ * runs into a new base, keeping the latest write of each id and dropping
+ * tombstones. Runs, merged bases and rebuilt bases are all built without the
+ * lock, so queries only wait while one is swapped in or a write is logged.
+ * Queries may run concurrently with each other, with writes and with compaction;
+ * writes (Insert, Erase, Build, Compact and Wait) must come from one thread at a time. */
+template <typename T>
+class LogRangeMap {
+    // An immutable RangeMap over a batch of writes
+    struct Run {
+        RangeMap<T> Map;
+        std::vector<T> S, E;            // Each write; kept so compaction can merge runs
+        std::vector<size_t> Ids;        // Id of each interval in Map
+        std::vector<uint64_t> Seqs;     // Sequence number of each interval in Map
+    };
+
+    // A write not yet frozen into a run
+    struct Write {
+        T A, B;
+        size_t Id;
+        uint64_t Seq;
+    };
+
+    std::unique_ptr<Run> Base;                  // Compacted intervals
+    std::vector<std::unique_ptr<Run> > Runs;    // Frozen batches of writes, oldest first
+    std::vector<Write> Buf;                     // Writes not yet frozen into a run
+    std::unordered_map<size_t, uint64_t> Live;  // Sequence number of the latest write of each live id
+    uint64_t Seq = 0;                           // Sequence number of the last write
+    size_t RunSize;                             // Writes buffered before freezing a run
+    size_t MaxRuns;                             // Runs allowed before compacting
+    bool Compacting = false;                    // Whether a compaction is in progress
+    std::thread Worker;                         // Background compaction thread
+    mutable std::shared_mutex Mtx;              // Guards everything above except Worker
+
+    // Builds a run from arrays of writes
+    static std::unique_ptr<Run> MakeRun(std::vector<T>&& S, std::vector<T>&& E,
+                                        std::vector<size_t>&& Ids, std::vector<uint64_t>&& Seqs) {
+        std::unique_ptr<Run> R(new Run);
+        R->Map.Build(S.data(), E.data(), S.size());
+        R->S = std::move(S);
+        R->E = std::move(E);
+        R->Ids = std::move(Ids);
+        R->Seqs = std::move(Seqs);
+        return R;
+    }
+
+    /* Merges runs into one holding the latest write of each id, dropping ids whose
+     * latest write is a tombstone. Only reads the runs, which are immutable.
+     * Rs:      The runs to merge; every write newer than them must be in later runs */
+    static std::unique_ptr<Run> Merge(const std::vector<const Run*>& Rs) {
+        std::unordered_map<size_t, std::pair<const Run*, size_t> > Latest;   // Latest write of each id
+        for (const Run* R : Rs) {
+            for (size_t i = 0; i < R->Ids.size(); ++i) {
+                auto It = Latest.emplace(R->Ids[i], std::make_pair(R, i)).first;
+                if (It->second.first->Seqs[It->second.second] < R->Seqs[i])
+                    It->second = std::make_pair(R, i);
+            }
+        }
+        std::vector<T> S, E;
+        std::vector<size_t> Ids;
+        std::vector<uint64_t> Seqs;
+        for (const auto& kv : Latest) {
+            const Run& R = *kv.second.first;
+            const size_t i = kv.second.second;
+            if (!(R.S[i] < R.E[i]))
+                continue;   // Erased, or empty and so never returned
+            S.push_back(R.S[i]);
+            E.push_back(R.E[i]);
+            Ids.push_back(kv.first);
+            Seqs.push_back(R.Seqs[i]);
+        }
+        return MakeRun(std::move(S), std::move(E), std::move(Ids), std::move(Seqs));
+    }
+
+    /* Logs a write; requires an exclusive lock
+     * Return:  True if the buffer is full and should be frozen once the lock is released */
+    bool Log(const T& a, const T& b, size_t Id) {
+        Buf.push_back(Write{a, b, Id, Seq});
+        return Buf.size() >= RunSize;
+    }
+
+    /* Freezes the write buffer into a new run. The run is built from a copy of the
+     * buffer without the lock, and the writes stay in the buffer, where queries
+     * still see them, until the run is swapped in. Called by the writer without a lock. */
+    void Freeze() {
+        std::vector<T> S, E;
+        std::vector<size_t> Ids;
+        std::vector<uint64_t> Seqs;
+        // Only the writer changes the buffer, so it can be read without the lock and
+        // cannot change before the run is swapped in
+        for (const Write& w : Buf) {
+            S.push_back(w.A);
+            E.push_back(w.B);
+            Ids.push_back(w.Id);
+            Seqs.push_back(w.Seq);
+        }
+        if (Ids.empty())
+            return;
+        const size_t k = Ids.size();
+        std::unique_ptr<Run> R = MakeRun(std::move(S), std::move(E), std::move(Ids), std::move(Seqs));
+        std::unique_lock<std::shared_mutex> Lock(Mtx);
+        Runs.push_back(std::move(R));
+        Buf.erase(Buf.begin(), Buf.begin() + k);
+    }
+
+    // Starts a background compaction if one is needed; called by the writer without a lock
+    void MaybeCompact(bool Force) {
+        {
+            std::shared_lock<std::shared_mutex> Lock(Mtx);
+            if (Compacting || (!Force && Runs.size() < MaxRuns))
+                return;
+        }
+        Wait();     // The previous compaction has swapped in its base and is finishing up
+        // The base and the runs frozen so far are immutable, so they can be merged without the lock
+        std::vector<const Run*> Rs;
+        size_t K;
+        {
+            std::unique_lock<std::shared_mutex> Lock(Mtx);
+            if (Base)
+                Rs.push_back(Base.get());
+            for (const auto& R : Runs)
+                Rs.push_back(R.get());
+            K = Runs.size();
+            Compacting = true;
+        }
+        Worker = std::thread([this, K](std::vector<const Run*> Rs) {
+            // Declared before the lock so the old base and runs are freed after it is released
+            std::unique_ptr<Run> NB = Merge(Rs);
+            std::vector<std::unique_ptr<Run> > Old;
+            Old.reserve(K);
+            std::unique_lock<std::shared_mutex> Lock(Mtx);
+            Base.swap(NB);
+            for (size_t k = 0; k < K; ++k)
+                Old.push_back(std::move(Runs[k]));
+            Runs.erase(Runs.begin(), Runs.begin() + K);
+            Compacting = false;
+        }, std::move(Rs));
+    }
+
+    // Whether a write is the latest one of a live interval; requires a lock
+    bool IsLive(size_t Id, uint64_t S) const {
+        auto It = Live.find(Id);
+        return (It != Live.end()) && (It->second == S);
+    }
+
+    // Appends the live ids of a run containing p to Out; requires a lock
+    void QueryRun(const Run& R, const T& p, std::vector<size_t>& Out) const {
+        for (size_t i : R.Map.Query(p)) {
+            if (IsLive(R.Ids[i], R.Seqs[i]))
+                Out.push_back(R.Ids[i]);
+        }
+    }
+
+public:
+    /* RunSize: Number of writes buffered before they are frozen into a run
+     * MaxRuns: Number of runs that triggers a background compaction */
+    explicit LogRangeMap(size_t RunSize = 1024, size_t MaxRuns = 8) : RunSize(RunSize), MaxRuns(MaxRuns) { }
+
+    LogRangeMap(const LogRangeMap&) = delete;
+    LogRangeMap& operator=(const LogRangeMap&) = delete;
+
+    ~LogRangeMap() {
+        Wait();
+    }
+
+    /* Replaces the contents with a list of intervals like [a, b) with ids 0 ... N - 1
+     * S:   An array of interval starting values
+     * E:   An array of interval closing values
+     * N:   The number of elements in S and E */
+    void Build(const T* S, const T* E, const size_t N) {
+        Wait();
+        // Only the writer changes Seq, so the new base can be built before taking the lock
+        std::vector<size_t> Ids(N);
+        std::vector<uint64_t> Seqs(N);
+        std::unordered_map<size_t, uint64_t> L;
+        for (size_t i = 0; i < N; ++i) {
+            Ids[i] = i;
+            Seqs[i] = Seq + i + 1;
+            L[i] = Seqs[i];
+        }
+        std::unique_ptr<Run> NB = MakeRun(std::vector<T>(S, S + N), std::vector<T>(E, E + N), std::move(Ids), std::move(Seqs));
+        // Declared before the lock so the old contents are freed after it is released
+        std::vector<std::unique_ptr<Run> > Old;
+        std::vector<Write> OldBuf;
+        std::unique_lock<std::shared_mutex> Lock(Mtx);
+        Base.swap(NB);
+        Runs.swap(Old);
+        Buf.swap(OldBuf);
+        Live.swap(L);
+        Seq += N;
+    }
+
+    /* Inserts the interval [a, b); an existing interval with the same id is replaced
+     * a:   Interval starting value
+     * b:   Interval closing value
+     * Id:  Id of the interval */
+    void Insert(const T& a, const T& b, size_t Id) {
+        std::unique_lock<std::shared_mutex> Lock(Mtx);
+        Live[Id] = ++Seq;
+        const bool Full = Log(a, b, Id);
+        Lock.unlock();
+        if (Full) {
+            Freeze();
+            MaybeCompact(false);
+        }
+    }
+
+    /* Removes an interval
+     * Id:      Id of the interval
+     * Return:  True if the interval was present */
+    bool Erase(size_t Id) {
+        std::unique_lock<std::shared_mutex> Lock(Mtx);
+        if (Live.erase(Id) == 0)
+            return false;
+        ++Seq;
+        const bool Full = Log(T(), T(), Id);  // Tombstone
+        Lock.unlock();
+        if (Full) {
+            Freeze();
+            MaybeCompact(false);
+        }
+        return true;
+    }
+
+    // Starts a background compaction unless one is already running
+    void Compact() {
+        Freeze();
+        MaybeCompact(true);
+    }
+
+    // Waits for any running compaction to finish
+    void Wait() {
+        if (Worker.joinable())
+            Worker.join();
+    }
+
+    // Number of writes kept in the base, the runs and the buffer, including replaced and erased ones
+    size_t Stored() const {
+        std::shared_lock<std::shared_mutex> Lock(Mtx);
+        size_t n = Buf.size() + (Base ? Base->Ids.size() : 0);
+        for (const auto& R : Runs)
+            n += R->Ids.size();
+        return n;
+    }
+
+    /* Given a query point, finds all intervals containing the point
+     * p:       The query point
+     * Out:     Output; sorted ids of all intervals containing the point */
+    void Query(const T& p, std::vector<size_t>& Out) const {
+        Out.clear();
+        std::shared_lock<std::shared_mutex> Lock(Mtx);
+        if (Base)
+            QueryRun(*Base, p, Out);
+        for (const auto& R : Runs)
+            QueryRun(*R, p, Out);
+        for (const Write& w : Buf) {
+            if (!(p < w.A) && (p < w.B) && IsLive(w.Id, w.Seq))
+                Out.push_back(w.Id);
+        }
+        std::sort(Out.begin(), Out.end());
+    }
+};
+
+#endif
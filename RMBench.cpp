@@ -0,0 +1,489 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   RMBench.cpp
+// Desc:   Benchmarks for RangeMap builds and queries
+//================================================================================
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory_resource>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RangeMap.h"
+#include "DynRangeMap.h"
+#include "RMGen.h"
+#include "RangeMapProbe.h"
+
+using namespace std;
+
+/* Generates short uniform intervals over [0, 1e9) and uniform query points with RMGen
+ * N:       Number of intervals
+ * M:       Number of queries
+ * S, E:    Output; interval starting and closing values
+ * Q:       Output; query points */
+template <typename T>
+void RandomData(const size_t N, const size_t M, vector<T>& S, vector<T>& E, vector<T>& Q) {
+    RMGen::Params P;
+    P.Seed = N;
+    P.Length = 500;     // Lengths in [1, 1000)
+    RMGen::Intervals(RMGen::Shape::Uniform, N, P, S, E);
+    P.Seed += 1;
+    RMGen::Queries(RMGen::Points::Uniform, M, P, S, E, Q);
+}
+
+/* Times random point queries against each search layout
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+void BenchLayouts(const size_t N, const size_t M) {
+    vector<T> S, E, Q;
+    RandomData(N, M, S, E, Q);
+    const SearchLayout Layouts[] = {SearchLayout::Sorted, SearchLayout::Eytzinger, SearchLayout::STree};
+    const char* Names[] = {"Sorted", "Eytzinger", "STree"};
+    for (int l = 0; l < 3; ++l) {
+        RangeMap<T> rm;
+        rm.SetLayout(Layouts[l]);
+        rm.Build(S.data(), E.data(), N);
+        size_t Sum = 0;     // Keeps the queries from being optimized away
+        auto st = chrono::steady_clock::now();
+        for (const T& q : Q)
+            Sum += rm.Query(q).size();
+        chrono::duration<double, nano> t = chrono::steady_clock::now() - st;
+        cout << N << "\t" << Names[l] << "\t" << (t.count() / M) << " ns/query\t(" << Sum << ")" << endl;
+    }
+}
+
+/* Times QueryBatch against one Query call per point on the default layout
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+void BenchBatch(const size_t N, const size_t M) {
+    vector<T> S, E, Q;
+    RandomData(N, M, S, E, Q);
+    RangeMap<T> rm;
+    rm.Build(S.data(), E.data(), N);
+    // Size the output first so the timed call copies every result
+    vector<size_t> ROff(M + 1);
+    vector<size_t> RIdx(rm.QueryBatch(Q.data(), M, ROff.data(), nullptr, 0));
+    size_t Sum = 0;
+    auto st = chrono::steady_clock::now();
+    for (const T& q : Q)
+        Sum += rm.Query(q).size();
+    chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+    st = chrono::steady_clock::now();
+    rm.QueryBatch(Q.data(), M, ROff.data(), RIdx.data(), RIdx.size());
+    chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+    cout << N << "\tQuery\t" << (t1.count() / M) << " ns/query\t(" << Sum << ")" << endl;
+    cout << N << "\tQueryBatch\t" << (t2.count() / M) << " ns/query\t(" << ROff[M] << ")" << endl;
+}
+
+/* Times QuerySorted against one Query call per point for sorted query points
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+void BenchSorted(const size_t N, const size_t M) {
+    vector<T> S, E, Q;
+    RandomData(N, M, S, E, Q);
+    sort(Q.begin(), Q.end());
+    RangeMap<T> rm;
+    rm.Build(S.data(), E.data(), N);
+    // Size the output first so the timed call copies every result
+    vector<size_t> ROff(M + 1);
+    vector<size_t> RIdx(rm.QuerySorted(Q.data(), M, ROff.data(), nullptr, 0));
+    size_t Sum = 0;
+    auto st = chrono::steady_clock::now();
+    for (const T& q : Q)
+        Sum += rm.Query(q).size();
+    chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+    st = chrono::steady_clock::now();
+    rm.QuerySorted(Q.data(), M, ROff.data(), RIdx.data(), RIdx.size());
+    chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+    cout << N << "\tQuery (sorted)\t" << (t1.count() / M) << " ns/query\t(" << Sum << ")" << endl;
+    cout << N << "\tQuerySorted\t" << (t2.count() / M) << " ns/query\t(" << ROff[M] << ")" << endl;
+}
+
+/* Times a Cursor against Query for a random walk of query points
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+void BenchCursor(const size_t N, const size_t M) {
+    vector<T> S, E, Q;
+    RandomData(N, M, S, E, Q);
+    // Each point is a small random step from the previous one
+    RMGen::Rng Gen(M);
+    Q[0] = T(500000000);
+    for (size_t i = 1; i < M; ++i)
+        Q[i] = Q[i - 1] + T(Gen.Below(2001) - 1000);
+    RangeMap<T> rm;
+    rm.Build(S.data(), E.data(), N);
+    typename RangeMap<T>::Cursor Cur(rm);
+    size_t Sum1 = 0, Sum2 = 0;
+    auto st = chrono::steady_clock::now();
+    for (const T& q : Q)
+        Sum1 += rm.Query(q).size();
+    chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+    st = chrono::steady_clock::now();
+    for (const T& q : Q)
+        Sum2 += Cur.Query(q).size();
+    chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+    cout << N << "\tQuery (walk)\t" << (t1.count() / M) << " ns/query\t(" << Sum1 << ")" << endl;
+    cout << N << "\tCursor\t" << (t2.count() / M) << " ns/query\t(" << Sum2 << ")" << endl;
+}
+
+/* Times random point queries that read every returned index, storing indices
+ * as size_t and as uint32_t
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+void BenchWidth(const size_t N, const size_t M) {
+    vector<T> S, E, Q;
+    RandomData(N, M, S, E, Q);
+    RangeMap<T> r8;
+    RangeMap<T, uint32_t> r4;
+    r8.Build(S.data(), E.data(), N);
+    r4.Build(S.data(), E.data(), N);
+    size_t Sum1 = 0, Sum2 = 0;
+    auto st = chrono::steady_clock::now();
+    for (const T& q : Q) {
+        for (size_t i : r8.Query(q))
+            Sum1 += i;
+    }
+    chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+    st = chrono::steady_clock::now();
+    for (const T& q : Q) {
+        for (size_t i : r4.Query(q))
+            Sum2 += i;
+    }
+    chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+    cout << N << "\tsize_t indices\t" << (t1.count() / M) << " ns/query\t(" << Sum1 << ")" << endl;
+    cout << N << "\tuint32_t indices\t" << (t2.count() / M) << " ns/query\t(" << Sum2 << ")" << endl;
+}
+
+/* Times random point queries with each search layout on a map with the default
+ * NoProbe, whose hooks are disabled, and on one recording into CountingProbe
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+void BenchProbe(const size_t N, const size_t M) {
+    vector<T> S, E, Q;
+    RandomData(N, M, S, E, Q);
+    const char* Names[] = {"Sorted", "Eytzinger", "STree"};
+    auto Time = [&Q](const auto& rm, size_t& Sum) {
+        const auto st = chrono::steady_clock::now();
+        for (const T& q : Q)
+            Sum += rm.Query(q).size();
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - st).count() / Q.size();
+    };
+    for (SearchLayout L : {SearchLayout::Sorted, SearchLayout::Eytzinger, SearchLayout::STree}) {
+        RangeMap<T> r1;
+        RangeMap<T, size_t, CountingProbe<> > r2;
+        r1.SetLayout(L);
+        r2.SetLayout(L);
+        r1.Build(S.data(), E.data(), N);
+        r2.Build(S.data(), E.data(), N);
+        size_t Sum1 = 0, Sum2 = 0;
+        const double t1 = Time(r1, Sum1), t2 = Time(r2, Sum2);
+        cout << N << "\t" << Names[int(L)] << " NoProbe\t" << t1 << " ns/query\t(" << Sum1 << ")" << endl;
+        cout << N << "\t" << Names[int(L)] << " CountingProbe\t" << t2 << " ns/query\t(" << Sum2 << ")" << endl;
+    }
+}
+
+/* Times the branch-free binary search used by Query against std::upper_bound on
+ * sorted tables sized to fit in L1, L2 and L3 cache and to spill to DRAM
+ * M:   Number of searches per table */
+template <typename T>
+void BenchSearch(const size_t M) {
+    const size_t Bytes[] = {16 << 10, 256 << 10, 8 << 20, 256 << 20};
+    const char* Level[] = {"L1", "L2", "L3", "DRAM"};
+    RMGen::Rng Gen(M);
+    for (int l = 0; l < 4; ++l) {
+        const size_t n = Bytes[l] / sizeof(T);
+        vector<T> t(n), Q(M);
+        for (size_t i = 0; i < n; ++i)
+            t[i] = T(3 * i);
+        for (T& q : Q)
+            q = T(Gen.Below(3 * n + 3));
+        size_t Sum1 = 0, Sum2 = 0;
+        auto st = chrono::steady_clock::now();
+        for (const T& q : Q)
+            Sum1 += (upper_bound(t.begin(), t.end(), q) - t.begin()) - 1;
+        chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+        st = chrono::steady_clock::now();
+        for (const T& q : Q)
+            Sum2 += RMImpl::FindSlot(t.data(), n, q);
+        chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+        cout << n << "\t" << Level[l] << " upper_bound\t" << (t1.count() / M) << " ns/search\t(" << Sum1 << ")" << endl;
+        cout << n << "\t" << Level[l] << " branch-free\t" << (t2.count() / M) << " ns/search\t(" << Sum2 << ")" << endl;
+    }
+}
+
+/* Times the radix argsort used by Build for arithmetic types, on one thread and
+ * on P threads, against a comparison sort
+ * N:   Number of values
+ * P:   Number of threads */
+template <typename T>
+void BenchArgSort(const size_t N, const size_t P) {
+    vector<T> S, E, Q;
+    RandomData(N, 0, S, E, Q);
+    vector<size_t> I1(N), I2(N), I3(N);
+    iota(I1.begin(), I1.end(), 0);
+    iota(I2.begin(), I2.end(), 0);
+    iota(I3.begin(), I3.end(), 0);
+    RMImpl::SortScratch<T> W;
+    W.Fit(N, P);
+    auto st = chrono::steady_clock::now();
+    RMImpl::RadixSortIndices(S.data(), I1, 1, W);
+    chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+    st = chrono::steady_clock::now();
+    RMImpl::RadixSortIndices(S.data(), I3, P, W);
+    chrono::duration<double, nano> t3 = chrono::steady_clock::now() - st;
+    st = chrono::steady_clock::now();
+    sort(I2.begin(), I2.end(), [&S](size_t i1, size_t i2) { return (S[i1] < S[i2]) || (!(S[i2] < S[i1]) && (i1 < i2)); });
+    chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+    cout << N << "\tRadix argsort\t" << (t1.count() / N) << " ns/element" << endl;
+    cout << N << "\tRadix argsort (" << P << " threads)\t" << (t3.count() / N) << " ns/element\t(" << (I1 == I3) << ")" << endl;
+    cout << N << "\tComparison argsort\t" << (t2.count() / N) << " ns/element\t(" << (I1 == I2) << ")" << endl;
+}
+
+/* Times replacing intervals in a DynRangeMap against rebuilding a RangeMap
+ * N:   Number of intervals
+ * U:   Number of intervals replaced */
+template <typename T>
+void BenchDynamic(const size_t N, const size_t U) {
+    vector<T> S, E, Q;
+    RandomData(N, 0, S, E, Q);
+    DynRangeMap<T> dm;
+    dm.Build(S.data(), E.data(), N);
+    RMGen::Rng Gen(U);
+    auto st = chrono::steady_clock::now();
+    for (size_t k = 0; k < U; ++k) {
+        const size_t j = size_t(Gen.Below(N));
+        dm.Insert(S[j] + 1, E[j] + 1, j);
+    }
+    chrono::duration<double, nano> t1 = chrono::steady_clock::now() - st;
+    RangeMap<T> rm;
+    st = chrono::steady_clock::now();
+    rm.Build(S.data(), E.data(), N);
+    chrono::duration<double, nano> t2 = chrono::steady_clock::now() - st;
+    cout << N << "\tDynRangeMap update\t" << (t1.count() / U) << " ns/update" << endl;
+    cout << N << "\tRangeMap rebuild\t" << t2.count() << " ns/rebuild" << endl;
+}
+
+// Memory resource that tracks the bytes it has outstanding
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t Bytes = 0;
+
+private:
+    void* do_allocate(size_t n, size_t a) override {
+        Bytes += n;
+        return std::pmr::new_delete_resource()->allocate(n, a);
+    }
+    void do_deallocate(void* p, size_t n, size_t a) override {
+        Bytes -= n;
+        std::pmr::new_delete_resource()->deallocate(p, n, a);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override {
+        return this == &o;
+    }
+};
+
+const char* ShapeName(RMGen::Shape S) {
+    static const char* Names[] = {"uniform", "nested", "disjoint", "chained", "clustered", "powerlaw"};
+    return Names[int(S)];
+}
+
+const char* PointsName(RMGen::Points P) {
+    static const char* Names[] = {"uniform", "sorted", "zipf", "endpoints"};
+    return Names[int(P)];
+}
+
+// One measurement of the suite
+struct Record {
+    string Key;             // Key type
+    string Shape;           // Shape of the interval set
+    size_t N;               // Number of intervals
+    size_t Density;         // Requested mean number of intervals containing a point
+    string Dist;            // Query distribution
+    double BuildNs;         // Build time per interval
+    double QueryNs;         // Mean query time
+    double P50, P90, P99;   // Query time percentiles
+    double Bytes;           // Bytes of storage per interval
+    double Result;          // Mean number of intervals returned per query
+};
+
+// Settings of the suite
+struct SuiteOptions {
+    size_t MinN = 100;
+    size_t MaxN = 10000000;
+    size_t MaxEntries = 100000000;  // Configurations storing more indices than this are skipped
+    size_t M = 1000000;             // Queries per configuration
+    bool Json = false;
+};
+
+/* Generates N intervals of a shape over [0, 1e9) and M query points
+ * Sh:      Shape of the interval set
+ * N, M:    Number of intervals and queries
+ * D:       For RMGen::Shape::Uniform, the mean number of intervals containing a point;
+ *          limited by the domain for small N. Other shapes use the same interval length.
+ * Pt:      Query point distribution
+ * S, E:    Output; interval starting and closing values
+ * Q:       Output; query points */
+template <typename T>
+void SuiteData(RMGen::Shape Sh, const size_t N, const size_t M, const size_t D, RMGen::Points Pt, vector<T>& S, vector<T>& E, vector<T>& Q) {
+    RMGen::Params P;
+    P.Seed = N * 31 + D;
+    P.Length = max(1LL, min(P.Range / 4, (long long)(double(D) * P.Range / N)));
+    RMGen::Intervals(Sh, N, P, S, E);
+    P.Seed += 1;
+    RMGen::Queries(Pt, M, P, S, E, Q);
+}
+
+/* Measures building a map and querying it with each distribution
+ * Key:     Name of T
+ * Sh:      Shape of the interval set
+ * N:       Number of intervals
+ * D:       Mean number of intervals containing a point
+ * O:       Settings
+ * Out:     Output; one record per query distribution */
+template <typename T>
+void SuiteRun(const char* Key, RMGen::Shape Sh, const size_t N, const size_t D, const SuiteOptions& O, vector<Record>& Out) {
+    constexpr size_t BLOCK = 64;    // Queries timed together; single queries are too short for the clock
+    for (RMGen::Points Pt : {RMGen::Points::Uniform, RMGen::Points::Sorted, RMGen::Points::Zipf}) {
+        vector<T> S, E, Q;
+        SuiteData(Sh, N, O.M, D, Pt, S, E, Q);
+        CountingResource Counter;
+        RangeMap<T> rm(&Counter);
+        // Repeat small builds so the total is long enough to time
+        size_t Reps = 0;
+        auto st = chrono::steady_clock::now();
+        chrono::duration<double, nano> tb{0};
+        do {
+            rm.Build(S.data(), E.data(), N);
+            tb = chrono::steady_clock::now() - st;
+            ++Reps;
+        } while (tb.count() < 2e8 && Reps < 1000);
+        vector<double> Lat;
+        Lat.reserve(O.M / BLOCK + 1);
+        size_t Sum = 0;
+        st = chrono::steady_clock::now();
+        const auto t0 = st;
+        for (size_t b = 0; b < O.M; b += BLOCK) {
+            const size_t e = min(O.M, b + BLOCK);
+            for (size_t i = b; i < e; ++i)
+                Sum += rm.Query(Q[i]).size();
+            const auto t = chrono::steady_clock::now();
+            Lat.push_back(chrono::duration<double, nano>(t - st).count() / (e - b));
+            st = t;
+        }
+        chrono::duration<double, nano> tq = chrono::steady_clock::now() - t0;
+        sort(Lat.begin(), Lat.end());
+        auto Pct = [&Lat](double f) { return Lat[min(Lat.size() - 1, size_t(f * Lat.size()))]; };
+        Out.push_back(Record{Key, ShapeName(Sh), N, D, PointsName(Pt), tb.count() / Reps / N, tq.count() / O.M,
+                             Pct(0.5), Pct(0.9), Pct(0.99), double(Counter.Bytes) / N, double(Sum) / O.M});
+    }
+}
+
+// Writes the records as CSV or as a JSON array
+void WriteRecords(const vector<Record>& R, bool Json) {
+    if (!Json)
+        cout << "key,shape,n,density,dist,build_ns_per_interval,query_ns,p50_ns,p90_ns,p99_ns,bytes_per_interval,mean_result" << endl;
+    else
+        cout << "[" << endl;
+    for (size_t i = 0; i < R.size(); ++i) {
+        const Record& r = R[i];
+        if (!Json) {
+            cout << r.Key << "," << r.Shape << "," << r.N << "," << r.Density << "," << r.Dist << "," << r.BuildNs << "," << r.QueryNs << ","
+                 << r.P50 << "," << r.P90 << "," << r.P99 << "," << r.Bytes << "," << r.Result << endl;
+        }
+        else {
+            cout << "  {\"key\": \"" << r.Key << "\", \"shape\": \"" << r.Shape << "\", \"n\": " << r.N << ", \"density\": " << r.Density << ", \"dist\": \"" << r.Dist
+                 << "\", \"build_ns_per_interval\": " << r.BuildNs << ", \"query_ns\": " << r.QueryNs << ", \"p50_ns\": " << r.P50
+                 << ", \"p90_ns\": " << r.P90 << ", \"p99_ns\": " << r.P99 << ", \"bytes_per_interval\": " << r.Bytes
+                 << ", \"mean_result\": " << r.Result << "}" << (i + 1 < R.size() ? "," : "") << endl;
+        }
+    }
+    if (Json)
+        cout << "]" << endl;
+}
+
+/* Runs Build and Query over every combination of size, interval shape, key type
+ * and query distribution allowed by the settings. Uniform intervals are run at
+ * several densities; the other shapes at one.
+ * O:   Settings */
+void RunSuite(const SuiteOptions& O) {
+    using RMGen::Shape;
+    vector<Record> R;
+    for (size_t N = O.MinN; N <= O.MaxN; N *= 10) {
+        for (Shape Sh : {Shape::Uniform, Shape::Nested, Shape::Disjoint, Shape::Chained, Shape::Clustered, Shape::PowerLaw}) {
+            for (size_t D : {1, 16, 256}) {
+                if ((Sh != Shape::Uniform && D != 16) || N * max(D, Sh == Shape::Nested ? RMGen::Params().Depth : D) > O.MaxEntries)
+                    continue;
+                SuiteRun<int>("int", Sh, N, D, O, R);
+                SuiteRun<long long>("int64", Sh, N, D, O, R);
+                SuiteRun<double>("double", Sh, N, D, O, R);
+                cerr << "N = " << N << ", " << ShapeName(Sh) << ", density = " << D << " done" << endl;
+            }
+        }
+    }
+    WriteRecords(R, O.Json);
+}
+
+// Runs the comparisons between query methods, layouts and variants
+void RunComparisons() {
+    const size_t M = 1000000;
+    BenchSearch<int>(M);
+    BenchSearch<double>(M);
+    for (size_t N = 1000; N <= 10000000; N *= 10) {
+        BenchLayouts<int>(N, M);
+        BenchLayouts<double>(N, M);
+        BenchBatch<int>(N, M);
+        BenchSorted<int>(N, M);
+        BenchCursor<int>(N, M);
+        BenchWidth<int>(N, M);
+        BenchProbe<int>(N, M);
+        BenchArgSort<int>(N, thread::hardware_concurrency());
+        BenchArgSort<double>(N, thread::hardware_concurrency());
+        BenchDynamic<int>(N, 10000);
+    }
+}
+
+/* Usage: RMBench [--json] [--min-n N] [--max-n N] [--max-entries N] [--queries M] [--compare]
+ * Runs the suite and writes CSV (or JSON) to stdout; --compare instead runs the
+ * comparisons between query methods, layouts and variants. Sizes go up to 1e7
+ * intervals by default; pass --max-n 100000000 for 1e8, which needs several GB. */
+int main(int argc, char** argv) {
+    SuiteOptions O;
+    bool Compare = false;
+    for (int i = 1; i < argc; ++i) {
+        auto Num = [&](size_t& V) {
+            if (i + 1 < argc)
+                V = size_t(atof(argv[++i]));
+        };
+        if (!strcmp(argv[i], "--json"))
+            O.Json = true;
+        else if (!strcmp(argv[i], "--compare"))
+            Compare = true;
+        else if (!strcmp(argv[i], "--min-n"))
+            Num(O.MinN);
+        else if (!strcmp(argv[i], "--max-n"))
+            Num(O.MaxN);
+        else if (!strcmp(argv[i], "--max-entries"))
+            Num(O.MaxEntries);
+        else if (!strcmp(argv[i], "--queries"))
+            Num(O.M);
+        else {
+            cerr << "Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+    if (Compare)
+        RunComparisons();
+    else
+        RunSuite(O);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+#================================================================================
+# Author: Nicholas T. Smith
+# File:   RMCodegen.sh
+# Desc:   Checks that disabled instrumentation hooks compile to nothing
+#================================================================================
+# Compiles Query and Count of RangeMap with the default NoProbe, then again from
+# a copy of RangeMap.h with every hook deleted, and compares the disassembly of
+# the two. Any difference means a disabled hook still costs something.
+# Usage:    ./RMCodegen.sh [compiler flags]     (default -O2; CXX picks the compiler)
+set -e
+CXX=${CXX:-g++}
+[ $# -gt 0 ] || set -- -O2
+Src=$(cd "$(dirname "$0")" && pwd)
+Dir=$(mktemp -d)
+trap 'rm -rf "$Dir"' EXIT
+mkdir "$Dir/hooks" "$Dir/bare"
+cp "$Src/RangeMap.h" "$Dir/hooks/RangeMap.h"
+# Every hook is an `if (constexpr) (Probe::Enabled)` followed by a single statement;
+# the search step counter they read is removed along with them
+sed -e '/if \(constexpr \)\{0,1\}(Probe::Enabled)/{N;d;}' -e '/unsigned Steps = 0;/d' \
+    -e 's/, unsigned\* Steps//' -e 's/, Probe::Enabled ? &Steps : nullptr//' "$Src/RangeMap.h" > "$Dir/bare/RangeMap.h"
+Hooks=$(grep -c 'Probe::Enabled)$' "$Src/RangeMap.h" || true)
+if [ "$Hooks" -eq 0 ] || grep -v '^ *\*' "$Dir/bare/RangeMap.h" | grep -q 'Probe::Enabled\|\bSteps\b'; then
+    echo "RMCodegen: could not strip the hooks from RangeMap.h"
+    exit 2
+fi
+cat > "$Dir/Query.cpp" << 'EOF'
+#include "RangeMap.h"
+// Out-of-line callers so each instantiation is emitted once; every layout is reachable at run time
+#define RM_CALLERS(T, I) \
+    void Query_##T##_##I(const RangeMap<T, I>& rm, const T& p, BasicIndexView<I>& Out) { Out = rm.Query(p); } \
+    size_t Count_##T##_##I(const RangeMap<T, I>& rm, const T& p) { return rm.Count(p); }
+RM_CALLERS(int, size_t)
+RM_CALLERS(double, size_t)
+RM_CALLERS(float, uint32_t)
+RM_CALLERS(long, uint16_t)
+EOF
+for V in hooks bare; do
+    "$CXX" -std=c++17 "$@" -I"$Dir/$V" -c "$Dir/Query.cpp" -o "$Dir/$V.o"
+    objdump -d -C --no-show-raw-insn "$Dir/$V.o" | tail -n +3 > "$Dir/$V.s"
+done
+if ! diff "$Dir/hooks.s" "$Dir/bare.s" > "$Dir/diff.txt"; then
+    head -n 40 "$Dir/diff.txt"
+    echo "RMCodegen: FAIL ($Hooks hooks; Query and Count differ from the hook-free build)"
+    exit 1
+fi
+echo "RMCodegen: PASS ($Hooks hooks; $(grep -c . "$Dir/hooks.s") identical lines of Query and Count)"
@@ -0,0 +1,198 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   RMGen.h
+// Desc:   Deterministic interval and query point generators for tests and benchmarks
+//================================================================================
+#ifndef RM_GEN_H
+#define RM_GEN_H
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/* Generators for interval sets and query points covering the shapes that stress
+ * RangeMap differently: deep nesting makes every active set large, disjoint and
+ * chained intervals keep them tiny, clusters and power-law lengths skew them, and
+ * Zipfian queries concentrate on a few hot spots. Every generator takes a seed and
+ * uses its own random number code rather than <random> distributions, so the same
+ * seed gives the same data with any standard library. Values lie in [0, Range)
+ * and are converted to T, so Range must fit in T. */
+namespace RMGen {
+    // Shapes of generated interval sets
+    enum class Shape {
+        Uniform,    // Uniform starts with uniform lengths in [1, 2 * Length)
+        Nested,     // Stacks of Depth intervals sharing a centre, each containing the next
+        Disjoint,   // Non-overlapping intervals, one in each of N equal slots
+        Chained,    // Consecutive intervals overlapping their neighbours by about Length / 4
+        Clustered,  // Starts gathered around Clusters centres
+        PowerLaw    // Uniform starts with Pareto distributed lengths; a few are very long
+    };
+
+    // Distributions of generated query points
+    enum class Points {
+        Uniform,    // Independent uniform points
+        Sorted,     // Uniform points in increasing order, as when replaying a sorted stream
+        Zipf,       // Points near Hot hot spots chosen with Zipfian frequencies
+        Endpoints   // Interval endpoints and their neighbours, where ties are decided
+    };
+
+    // Parameters shared by the generators
+    struct Params {
+        uint64_t Seed = 1;
+        long long Range = 1000000000;   // Values lie in [0, Range)
+        long long Length = 1000;        // Typical interval length
+        size_t Depth = 64;              // Intervals per stack for Shape::Nested
+        size_t Clusters = 16;           // Number of clusters for Shape::Clustered
+        double Alpha = 1.2;             // Tail exponent for Shape::PowerLaw
+        size_t Hot = 1024;              // Number of hot spots for Points::Zipf
+        double Skew = 1.1;              // Zipf exponent for Points::Zipf
+    };
+
+    // Small, fast generator (SplitMix64) with a fully specified output sequence
+    class Rng {
+        uint64_t X;
+
+    public:
+        explicit Rng(uint64_t Seed) : X(Seed) { }
+
+        uint64_t Next() {
+            uint64_t z = (X += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // Uniform in [0, n) for n > 0; the bias is below 2^-32 for n < 2^32
+        long long Below(long long n) {
+            return (long long)(Next() % uint64_t(n));
+        }
+
+        // Uniform in [0, 1)
+        double Unit() {
+            return double(Next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+    };
+
+    /* Generates N intervals [S[i], E[i])
+     * Sh:      Shape of the set
+     * N:       Number of intervals
+     * P:       Parameters
+     * S, E:    Output; interval starting and closing values */
+    template <typename T>
+    void Intervals(Shape Sh, const size_t N, const Params& P, std::vector<T>& S, std::vector<T>& E) {
+        Rng G(P.Seed);
+        const long long R = P.Range;
+        const long long L = std::max(1LL, std::min(P.Length, R / 2));
+        std::vector<long long> A(N), B(N);
+        std::vector<long long> C(std::max<size_t>(1, P.Clusters));
+        for (long long& c : C)
+            c = G.Below(R);
+        long long Centre = 0;   // Centre of the current stack for Shape::Nested
+        for (size_t i = 0; i < N; ++i) {
+            switch (Sh) {
+            case Shape::Uniform:
+                A[i] = G.Below(R);
+                B[i] = A[i] + 1 + G.Below(2 * L - 1);
+                break;
+            case Shape::Nested: {
+                // Interval k of a stack has half-width proportional to Depth - k
+                const size_t D = std::max<size_t>(1, P.Depth);
+                const size_t k = i % D;
+                if (k == 0)
+                    Centre = L + G.Below(std::max(1LL, R - 2 * L));
+                const long long W = std::max(1LL, L * (long long)(D - k) / (long long)D);
+                A[i] = Centre - W;
+                B[i] = Centre + W;
+                break;
+            }
+            case Shape::Disjoint: {
+                const long long W = std::max(1LL, R / (long long)N);
+                const long long a = (long long)i * W;
+                A[i] = a + G.Below(W);
+                B[i] = A[i] + 1 + G.Below(std::max(1LL, a + W - A[i]));
+                break;
+            }
+            case Shape::Chained: {
+                const long long W = std::max(1LL, std::min(R / (long long)N, L));
+                A[i] = (long long)i * W;
+                B[i] = A[i] + W + 1 + G.Below(W / 4 + 1);
+                break;
+            }
+            case Shape::Clustered: {
+                // A sum of uniforms approximates a normal spread around the centre
+                const long long c = C[G.Below((long long)C.size())];
+                const long long Spread = std::max(1LL, R / (long long)(8 * C.size()));
+                long long Off = 0;
+                for (int u = 0; u < 4; ++u)
+                    Off += G.Below(Spread);
+                A[i] = std::min(R - 2, std::max(0LL, c + Off - 2 * Spread));
+                B[i] = A[i] + 1 + G.Below(2 * L - 1);
+                break;
+            }
+            case Shape::PowerLaw: {
+                A[i] = G.Below(R);
+                const double Len = double(L) / 4 * std::pow(1.0 - G.Unit(), -1.0 / P.Alpha);
+                B[i] = A[i] + 1 + (long long)std::min(Len, double(R));
+                break;
+            }
+            }
+        }
+        // Nested and chained sets are generated in order; shuffle so input order is not a hint
+        for (size_t i = N; i > 1; --i) {
+            const size_t j = size_t(G.Below((long long)i));
+            std::swap(A[i - 1], A[j]);
+            std::swap(B[i - 1], B[j]);
+        }
+        S.resize(N);
+        E.resize(N);
+        for (size_t i = 0; i < N; ++i) {
+            S[i] = T(std::max(0LL, std::min(A[i], R - 1)));
+            E[i] = T(std::max(A[i] + 1, std::min(B[i], R)));
+        }
+    }
+
+    /* Generates M query points
+     * Pt:      Distribution of the points
+     * M:       Number of points
+     * P:       Parameters; the seed should differ from the one used for the intervals
+     * S, E:    The intervals, used by Points::Endpoints
+     * Q:       Output; query points */
+    template <typename T>
+    void Queries(Points Pt, const size_t M, const Params& P, const std::vector<T>& S, const std::vector<T>& E, std::vector<T>& Q) {
+        Rng G(P.Seed);
+        const long long R = P.Range;
+        Q.resize(M);
+        if (Pt == Points::Zipf) {
+            // Hot spot k is chosen with probability proportional to 1 / (k + 1)^Skew
+            const size_t H = std::max<size_t>(1, P.Hot);
+            std::vector<long long> Spot(H);
+            std::vector<double> Cdf(H);
+            double Sum = 0;
+            for (size_t k = 0; k < H; ++k) {
+                Spot[k] = G.Below(R);
+                Sum += 1.0 / std::pow(double(k + 1), P.Skew);
+                Cdf[k] = Sum;
+            }
+            const long long Jitter = std::max(1LL, P.Length);
+            for (T& q : Q) {
+                const size_t k = std::min(H - 1, size_t(std::upper_bound(Cdf.begin(), Cdf.end(), G.Unit() * Sum) - Cdf.begin()));
+                q = T(std::min(R - 1, Spot[k] + G.Below(Jitter)));
+            }
+            return;
+        }
+        if (Pt == Points::Endpoints && !S.empty()) {
+            for (T& q : Q) {
+                const size_t i = size_t(G.Below((long long)S.size()));
+                const long long v = (long long)((G.Next() & 1) ? S[i] : E[i]) + G.Below(3) - 1;
+                q = T(std::max(0LL, std::min(R - 1, v)));
+            }
+            return;
+        }
+        for (T& q : Q)
+            q = T(G.Below(R));
+        if (Pt == Points::Sorted)
+            std::sort(Q.begin(), Q.end());
+    }
+}
+
+#endif
@@ -3,17 +3,84 @@
 // File:   RMTest.h
 // Desc:   Unit tests for RangeMap
 //================================================================================
-#include <chrono>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <iomanip>
 #include <limits>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <numeric>
+#include <thread>
 #include <vector>
 #include <cstdlib>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <sys/resource.h>
 #include "RangeMap.h"
+#include "DeltaRangeMap.h"
+#include "DynRangeMap.h"
+#include "LogRangeMap.h"
+#include "AtomicRangeMap.h"
+#include "RangeMapIO.h"
+#include "RMGen.h"
+#include "RangeMapProbe.h"
 
 using namespace std;
 
-#define RUN_TEST(T) rv = RunTest<T>(MAXA, nt, tSum1, tSum2); cout << "Test:    " #T << endl; cout << "Result:  " << (rv ? "PASS" : "FAIL") << endl; cout << "Time Elapsed:\n\tBrute Force: " << tSum2.count() << "\n\tRangeMap: " << tSum1.count() << endl
+// Number of calls to the global operator new, to check code paths that must not allocate
+static std::atomic<size_t> NewCalls{0};
+
+void* operator new(size_t n) {
+    ++NewCalls;
+    if (void* p = malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    ++NewCalls;
+    return malloc(n ? n : 1);
+}
+
+// Used by std::pmr::new_delete_resource
+void* operator new(size_t n, std::align_val_t a) {
+    ++NewCalls;
+    const size_t A = std::max(size_t(a), sizeof(void*));
+    if (void* p = aligned_alloc(A, (std::max<size_t>(n, 1) + A - 1) / A * A))
+        return p;
+    throw std::bad_alloc();
+}
+
+// GCC flags the free calls once inlined next to code that called operator new
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    free(p);
+}
+
+#define RUN_TEST(T) rv = RunTest<T>(MAXA, nt); cout << "Test:    " #T << endl; cout << "Result:  " << (rv ? "PASS" : "FAIL") << endl
 
 /* Brute force approach for determining intervals that contain
  * a query point.
@@ -32,12 +99,56 @@ vector<size_t> SlowCheck(const T x, const T* S, const T* E, const size_t N) {
     return s;
 }
 
+// Compares a query result view against a reference set
+template <typename I>
+bool Same(const BasicIndexView<I>& v, const vector<size_t>& s) {
+    return (v.size() == s.size()) && equal(v.begin(), v.end(), s.begin());
+}
+
+/* Generates N uniform intervals with RMGen, seeded from rand() so runs differ
+ * Range:   Values lie in [0, Range)
+ * Length:  Interval lengths lie in [1, 2 * Length)
+ * S, E:    Output; interval starting and closing values */
 template <typename T>
-bool RunTest(const int MAXA, const int nt, std::chrono::duration<double>& tSum1, std::chrono::duration<double>& tSum2) {
-    // Timings
-    tSum1 = std::chrono::duration<double> {};
-    tSum2 = std::chrono::duration<double> {};
-    std::chrono::time_point<std::chrono::system_clock> st;
+void UniformData(const size_t N, const long long Range, const long long Length, vector<T>& S, vector<T>& E) {
+    RMGen::Params P;
+    P.Seed = rand();
+    P.Range = Range;
+    P.Length = Length;
+    RMGen::Intervals(RMGen::Shape::Uniform, N, P, S, E);
+}
+
+/* Checks QueryBatch or QuerySorted against the brute force approach for a list of points
+ * rm:      The RangeMap built from S and E
+ * P:       Query points; sorted first when testing QuerySorted
+ * Sorted:  Test QuerySorted instead of QueryBatch */
+template <typename T>
+bool BatchTest(const RangeMap<T>& rm, vector<T> P, const T* S, const T* E, const size_t N, bool Sorted) {
+    if (Sorted)
+        sort(P.begin(), P.end());
+    auto Run = [&](vector<size_t>& ROff, vector<size_t>& RIdx) {
+        return Sorted ? rm.QuerySorted(P.data(), P.size(), ROff.data(), RIdx.data(), RIdx.size()) :
+                        rm.QueryBatch(P.data(), P.size(), ROff.data(), RIdx.data(), RIdx.size());
+    };
+    vector<size_t> ROff(P.size() + 1);
+    vector<size_t> RIdx(1);
+    // Retry with a buffer of the reported size if the first is too small
+    size_t Tot = Run(ROff, RIdx);
+    if (Tot > RIdx.size()) {
+        RIdx.resize(Tot);
+        if (Run(ROff, RIdx) != Tot)
+            return false;
+    }
+    for (size_t i = 0; i < P.size(); ++i) {
+        auto s = SlowCheck<T>(P[i], S, E, N);
+        if (!Same(IndexView(RIdx.data() + ROff[i], RIdx.data() + ROff[i + 1]), s))
+            return false;
+    }
+    return true;
+}
+
+template <typename T>
+bool RunTest(const int MAXA, const int nt) {
     for (int k = 0; k < nt; ++k) {      // Loop over each random test case
         int ni = (rand() % 99) + 1;     // Generate a random test case
         vector<T> S(ni);
@@ -51,6 +162,28 @@ bool RunTest(const int MAXA, const int nt, std::chrono::duration<double>& tSum1,
         // Build a RangeMap
         RangeMap<T> rm;
         rm.Build(S.data(), E.data(), ni);
+        RangeMap<T> re;
+        re.SetLayout(SearchLayout::Eytzinger);
+        re.Build(S.data(), E.data(), ni);
+        RangeMap<T> rs;
+        rs.SetLayout(SearchLayout::STree);
+        rs.Build(S.data(), E.data(), ni);
+        RangeMap<T> rc;
+        rc.SetCountOnly(true);
+        rc.Build(S.data(), E.data(), ni);
+        DeltaRangeMap<T> dm(1 + rand() % 8);
+        dm.Build(S.data(), E.data(), ni);
+        DynRangeMap<T> dy;
+        dy.Build(S.data(), E.data(), ni);
+        vector<size_t> s3, s4;
+        typename RangeMap<T>::Cursor cur(rm);
+        // Checks the other RangeMap variants against the brute force result
+        auto Check = [&](const T p, const vector<size_t>& s2) {
+            dm.Query(p, s3);
+            dy.Query(p, s4);
+            return Same(re.Query(p), s2) && Same(rs.Query(p), s2) && Same(cur.Query(p), s2) && (s3 == s2) && (s4 == s2) &&
+                   (rm.Count(p) == s2.size()) && (rs.Count(p) == s2.size()) && (rc.Count(p) == s2.size()) && rc.Query(p).empty();
+        };
 
         // Get min and max values for testing ranges
         T n = S[0], x = E[0];
@@ -63,47 +196,809 @@ bool RunTest(const int MAXA, const int nt, std::chrono::duration<double>& tSum1,
         // Test absolute maximum value
         {
             T maxv = numeric_limits<T>::max();
-
-            st = std::chrono::system_clock::now();
             auto s1 = rm.Query(maxv);
-            tSum1 += (std::chrono::system_clock::now() - st);
-
-            st = std::chrono::system_clock::now();
             auto s2 = SlowCheck<T>(maxv, S.data(), E.data(), ni);
-            tSum2 += (std::chrono::system_clock::now() - st);
 
-            if (s1 != s2)
+            if (!Same(s1, s2))
+                return false;
+            if (!Check(maxv, s2))
                 return false;
         }
         // Test absolute minimum value
         {
             T minv = numeric_limits<T>::min();
-
-            st = std::chrono::system_clock::now();
             auto s1 = rm.Query(minv);
-            tSum1 += (std::chrono::system_clock::now() - st);
-
-            st = std::chrono::system_clock::now();
             auto s2 = SlowCheck<T>(minv, S.data(), E.data(), ni);
-            tSum2 += (std::chrono::system_clock::now() - st);
 
-            if (s1 != s2)
+            if (!Same(s1, s2))
+                return false;
+            if (!Check(minv, s2))
                 return false;
         }
         // Test from (min - 1) to (max + 1)
+        vector<T> P = {numeric_limits<T>::max(), numeric_limits<T>::min()};
         for (T i = (n - 1); i <= (x + 1); ++i) {
-            st = std::chrono::system_clock::now();
+            P.push_back(i);
             auto s1 = rm.Query(i);
-            tSum1 += (std::chrono::system_clock::now() - st);
-
-            st = std::chrono::system_clock::now();
             auto s2 = SlowCheck<T>(i, S.data(), E.data(), ni);
-            tSum2 += (std::chrono::system_clock::now() - st);
 
-            if (s1 != s2)
+            if (!Same(s1, s2))
+                return false;
+            if (!Check(i, s2))
+                return false;
+        }
+        // Test all of the above points as a batch and in sorted order
+        if (!BatchTest(rm, P, S.data(), E.data(), ni, false) || !BatchTest(rm, P, S.data(), E.data(), ni, true))
+            return false;
+    }
+    return true;
+}
+
+/* Checks a Cursor against Query on a map large enough that random jumps
+ * fall back from galloping to a binary search
+ * N:   Number of intervals
+ * M:   Number of queries */
+template <typename T>
+bool CursorTest(const int N, const int M) {
+    vector<T> S, E;
+    UniformData(N, 100000, 50, S, E);
+    RangeMap<T> rm;
+    rm.Build(S.data(), E.data(), N);
+    typename RangeMap<T>::Cursor cur(rm);
+    T p = 0;
+    for (int k = 0; k < M; ++k) {
+        // Mix small steps in either direction with large jumps
+        p = (k % 8 == 0) ? T(rand() % 100100) : T(p + (rand() % 21) - 10);
+        if (!Same(cur.Query(p), vector<size_t>(rm.Query(p).begin(), rm.Query(p).end())))
+            return false;
+    }
+    return true;
+}
+
+/* Checks that a parallel build gives the same results as a serial build
+ * N:   Number of intervals
+ * P:   Number of threads */
+template <typename T>
+bool ParallelTest(const int N, const size_t P) {
+    vector<T> S, E;
+    UniformData(N, 1000000, 1000, S, E);
+    RangeMap<T> rm, rp;
+    rm.SetWindowQueries(true);
+    rp.SetWindowQueries(true);
+    rm.Build(S.data(), E.data(), N);
+    rp.SetThreads(P);
+    rp.Build(S.data(), E.data(), N);
+    vector<size_t> R1(N), R2(N);
+    for (int j = 0; j < N; ++j) {
+        for (T p : {S[j], E[j]}) {
+            auto s1 = rm.Query(p);
+            if (!Same(rp.Query(p), vector<size_t>(s1.begin(), s1.end())))
+                return false;
+        }
+        // The window offsets are written by the parallel sweep too
+        const size_t n = rm.QueryRange(S[j], E[j], R1.data(), N);
+        if ((rp.QueryRange(S[j], E[j], R2.data(), N) != n) || !equal(R1.begin(), R1.begin() + n, R2.begin()))
+            return false;
+    }
+    return true;
+}
+
+/* Checks the radix argsort and the sorted values it keeps against a comparison sort,
+ * including negative values and duplicates (and -0 for floating point types)
+ * N:   Number of values
+ * P:   Number of threads */
+template <typename T>
+bool RadixTest(const int N, const size_t P = 1) {
+    vector<T> V(N);
+    for (int j = 0; j < N; ++j)
+        V[j] = T(rand() % 2001 - 1000) / ((j % 3) ? T(1) : T(7));
+    if (numeric_limits<T>::is_iec559)
+        V[0] = -T(0);
+    vector<size_t> I1(N), I2(N);
+    iota(I1.begin(), I1.end(), 0);
+    iota(I2.begin(), I2.end(), 0);
+    RMImpl::SortScratch<T> W;
+    RMImpl::RadixSortIndices(V.data(), I1, P, W);
+    sort(I2.begin(), I2.end(), [&V](size_t i1, size_t i2) { return (V[i1] < V[i2]) || (!(V[i2] < V[i1]) && (i1 < i2)); });
+    for (int j = 0; j < N; ++j) {
+        if (W.V[j] != V[I2[j]])
+            return false;
+    }
+    return I1 == I2;
+}
+
+/* Checks a mutable map against the brute force approach under random insertions and removals
+ * N:   Number of interval ids
+ * M:   Number of updates
+ * dm:  An empty DynRangeMap or LogRangeMap */
+template <typename T, typename Map>
+bool DynTest(const int N, const int M, Map& dm) {
+    vector<T> S(N), E(N);
+    vector<bool> In(N, false);
+    vector<size_t> s1;
+    for (int k = 0; k < M; ++k) {
+        // Insert, replace or remove a random interval
+        const int j = rand() % N;
+        if (rand() % 3) {
+            S[j] = rand() % 1000;
+            E[j] = S[j] + rand() % 100;
+            dm.Insert(S[j], E[j], j);
+            In[j] = true;
+        }
+        else if (dm.Erase(j) != In[j])
+            return false;
+        else
+            In[j] = false;
+        // Compare against the live intervals at a random point
+        const T p = rand() % 1100;
+        vector<size_t> s2;
+        for (int i = 0; i < N; ++i) {
+            if (In[i] && (S[i] <= p) && (p < E[i]))
+                s2.push_back(i);
+        }
+        dm.Query(p, s1);
+        if (s1 != s2)
+            return false;
+    }
+    return true;
+}
+
+/* Checks that a LogRangeMap that only sees erases still compacts and drops the
+ * erased intervals
+ * N:   Number of intervals */
+bool EraseOnlyTest(const int N) {
+    vector<int> S, E;
+    UniformData(N, 1000, 50, S, E);
+    LogRangeMap<int> lm(64, 2);
+    lm.Build(S.data(), E.data(), N);
+    vector<size_t> Out;
+    bool Ok = true;
+    for (int j = 0; j < N; j += 2) {
+        Ok = Ok && lm.Erase(j) && !lm.Erase(j);
+        lm.Query(S[j], Out);
+        Ok = Ok && !binary_search(Out.begin(), Out.end(), size_t(j));
+    }
+    lm.Wait();      // Compact does nothing while a compaction is running
+    lm.Compact();
+    lm.Wait();
+    // Only the odd ids are left once everything is merged
+    Ok = Ok && (lm.Stored() == size_t(N / 2));
+    for (int j = 0; j < N; j += 2)
+        lm.Erase(j + 1);
+    lm.Wait();
+    lm.Compact();
+    lm.Wait();
+    lm.Query(500, Out);
+    return Ok && (lm.Stored() == 0) && Out.empty();
+}
+
+/* Checks that queries running alongside a LogRangeMap writer never miss or repeat an
+ * interval while runs are frozen, compacted and rebuilt. Id j always holds [j, j + 2)
+ * and is only ever replaced by the same interval, so point p is contained by ids p - 1 and p.
+ * N:   Number of intervals
+ * M:   Number of writes */
+bool LogReadTest(const int N, const int M) {
+    vector<int> S(N), E(N);
+    for (int j = 0; j < N; ++j) {
+        S[j] = j;
+        E[j] = j + 2;
+    }
+    LogRangeMap<int> lm(32, 3);
+    lm.Build(S.data(), E.data(), N);
+    std::atomic<bool> Done{false}, Ok{true};
+    thread Reader([&]() {
+        unsigned Seed = 1;
+        vector<size_t> Out;
+        while (!Done) {
+            const int p = 1 + rand_r(&Seed) % (N - 1);
+            lm.Query(p, Out);
+            if (Out != vector<size_t>{size_t(p - 1), size_t(p)})
+                Ok = false;
+        }
+    });
+    for (int k = 0; k < M; ++k) {
+        const int j = rand() % N;
+        lm.Insert(S[j], E[j], j);
+        if (k % (M / 4) == 0)
+            lm.Build(S.data(), E.data(), N);
+    }
+    Done = true;
+    Reader.join();
+    return Ok;
+}
+
+/* Checks that readers of an AtomicRangeMap always see a complete version while a
+ * writer keeps rebuilding it. Version w holds intervals [j, j + 1 + w % K) for ids
+ * j = 0 ... N - 1, so any point p must be contained by exactly ids p - w % K ... p.
+ * N:   Number of intervals
+ * V:   Number of versions published
+ * R:   Number of reader threads */
+bool SnapshotTest(const int N, const int V, const int R) {
+    const int K = 8;
+    AtomicRangeMap<int> am;
+    std::atomic<bool> Done{false}, Ok{true};
+    vector<thread> Readers;
+    for (int r = 0; r < R; ++r) {
+        Readers.emplace_back([&, r]() {
+            AtomicRangeMap<int>::Reader rd(am);
+            unsigned Seed = r;
+            do {
+                const int p = K + rand_r(&Seed) % (N - K);
+                auto Pin = rd.Lock();
+                auto s = Pin->Query(p);
+                if (s.empty())
+                    continue;   // The initial empty version
+                bool Good = (s.size() <= size_t(K)) && (s[s.size() - 1] == size_t(p));
+                for (size_t i = 1; i < s.size(); ++i)
+                    Good = Good && (s[i] == s[i - 1] + 1);
+                if (!Good)
+                    Ok = false;
+            } while (!Done);
+        });
+    }
+    vector<int> S(N), E(N);
+    for (int w = 0; w < V; ++w) {
+        for (int j = 0; j < N; ++j) {
+            S[j] = j;
+            E[j] = j + 1 + w % K;
+        }
+        am.Build(S.data(), E.data(), N);
+    }
+    Done = true;
+    for (thread& t : Readers)
+        t.join();
+    return Ok;
+}
+
+/* Checks that more readers than fit in one block of slots can register at once
+ * while a writer keeps publishing, and that every one of them sees a complete version
+ * T:   Number of threads registering readers */
+bool ReadersTest(const int T) {
+    typedef AtomicRangeMap<int>::Reader Reader;
+    const size_t M = AtomicRangeMap<int>::BLOCK_READERS + 7;   // Readers held by each thread
+    AtomicRangeMap<int> am;
+    int S[] = {0, 5}, E[] = {10, 15};
+    am.Build(S, E, 2);
+    std::atomic<bool> Ok{true};
+    std::atomic<int> Left{T};
+    vector<thread> Th;
+    for (int t = 0; t < T; ++t) {
+        Th.emplace_back([&, t]() {
+            unsigned Seed = t;
+            vector<unique_ptr<Reader> > Rs;
+            for (size_t i = 0; i < M; ++i) {
+                Rs.emplace_back(new Reader(am));
+                auto Pin = Rs.back()->Lock();
+                if (Pin->Count(7) != 2)
+                    Ok = false;
+            }
+            --Left;
+            // Every reader stays registered until all threads have registered theirs
+            while (Left > 0) {
+                auto Pin = Rs[rand_r(&Seed) % M]->Lock();
+                if (Pin->Count(7) != 2)
+                    Ok = false;
+            }
+        });
+    }
+    while (Left > 0)
+        am.Build(S, E, 2);
+    for (thread& h : Th)
+        h.join();
+    Reader rd(am);
+    return Ok && (rd.Lock()->Count(12) == 1);
+}
+
+// The contents of a file
+string ReadFile(const char* Path) {
+    ifstream In(Path, ios::binary);
+    return string(istreambuf_iterator<char>(In), istreambuf_iterator<char>());
+}
+
+/* Checks that a saved and mapped map answers queries like the original and that
+ * damaged files are rejected
+ * N:       Number of intervals
+ * Path:    Scratch file to write */
+template <typename T>
+bool FileTest(const int N, const char* Path) {
+    vector<T> S, E;
+    UniformData(N, 100000, 250, S, E);
+    RangeMap<T> rm, rc;
+    rm.SetLayout(SearchLayout::Eytzinger);
+    rm.Build(S.data(), E.data(), N);
+    rc.SetCountOnly(true);
+    rc.Build(S.data(), E.data(), N);
+    MappedRangeMap<T> mm;
+    bool Ok = MappedRangeMap<T>::Save(rm, Path) && mm.Open(Path);
+    for (int j = 0; Ok && j < N; ++j) {
+        for (T p : {S[j], E[j], T(S[j] - 1)}) {
+            auto s1 = rm.Query(p);
+            Ok = Ok && Same(mm.Query(p), vector<size_t>(s1.begin(), s1.end())) && (mm.Count(p) == s1.size());
+        }
+    }
+    // Count-only maps keep only the offsets
+    Ok = Ok && MappedRangeMap<T>::Save(rc, Path) && mm.Open(Path);
+    for (int j = 0; Ok && j < N; ++j)
+        Ok = (mm.Count(S[j]) == rm.Count(S[j])) && mm.Query(S[j]).empty();
+    mm.Close();
+    // A flipped bit and a truncated file must both fail to open
+    string Data = ReadFile(Path);
+    string Bad = Data;
+    Bad[Bad.size() - 9] ^= 4;     // Just before the checksum
+    ofstream(Path, ios::binary | ios::trunc) << Bad;
+    Ok = Ok && !mm.Open(Path) && mm.Open(Path, false);
+    ofstream(Path, ios::binary | ios::trunc) << Data.substr(0, Data.size() - 8);
+    Ok = Ok && !mm.Open(Path, false);
+    // The other key type of the same size must not open it either
+    ofstream(Path, ios::binary | ios::trunc) << Data;
+    Ok = Ok && mm.Open(Path);
+    MappedRangeMap<typename conditional<is_integral<T>::value, float, int>::type> mo;
+    Ok = Ok && ((sizeof(T) != 4) || !mo.Open(Path));
+    mm.Close();
+    // Nor may a file whose offsets have another width, even unverified
+    Bad = Data;
+    uint32_t OffSize = 4;
+    memcpy(&Bad[offsetof(RMImpl::FileHeader, OffSize)], &OffSize, sizeof(OffSize));
+    ofstream(Path, ios::binary | ios::trunc) << Bad;
+    Ok = Ok && !mm.Open(Path, false);
+    remove(Path);
+    return Ok;
+}
+
+/* Checks that building a map file from a stream with little memory gives the
+ * same file as saving a map built in memory
+ * N:       Number of intervals
+ * Budget:  Memory budget of the external build in bytes
+ * Path:    Scratch file prefix */
+template <typename T>
+bool ExternalTest(const int N, const size_t Budget, const string& Path) {
+    vector<T> S, E;
+    UniformData(N, 100000, 250, S, E);
+    for (int j = 0; j < N; ++j) {
+        S[j] = S[j] - 1000;     // Include negative values
+        E[j] = E[j] - 1000;
+    }
+    if (N > 1) {    // Include -0 as a starting and a closing value
+        S[0] = -T(0);
+        E[1] = -T(0);
+        S[1] = min(S[1], T(-1));
+        E[0] = max(E[0], T(1));
+    }
+    RangeMap<T> rm;
+    rm.Build(S.data(), E.data(), N);
+    RangeMapFileBuilder<T> fb(Path + ".ext", Budget);
+    for (int j = 0; j < N; ++j)
+        fb.Add(S[j], E[j]);
+    const bool Ok = fb.Finish() && MappedRangeMap<T>::Save(rm, (Path + ".mem").c_str()) &&
+                    (ReadFile((Path + ".ext").c_str()) == ReadFile((Path + ".mem").c_str()));
+    remove((Path + ".ext").c_str());
+    remove((Path + ".mem").c_str());
+    return Ok;
+}
+
+/* Checks an external build spilling hundreds of runs with the number of open
+ * files limited well below the number of runs
+ * Path:    Scratch file prefix */
+bool ManyRunsTest(const string& Path) {
+    rlimit Old;
+    if (getrlimit(RLIMIT_NOFILE, &Old) != 0)
+        return false;
+    rlimit Low = Old;
+    Low.rlim_cur = std::min<rlim_t>(Old.rlim_cur, 256);
+    setrlimit(RLIMIT_NOFILE, &Low);
+    // 4096 bytes buffer 128 events of each kind, so 100000 intervals spill about 780 runs
+    const bool Ok = ExternalTest<int>(100000, 4096, Path);
+    setrlimit(RLIMIT_NOFILE, &Old);
+    return Ok;
+}
+
+/* Checks that intervals [a, b) with b < a are treated as empty by every layout,
+ * a parallel build, DeltaRangeMap and the external file builder
+ * N:       Number of intervals; about a third are reversed
+ * Path:    Scratch file prefix */
+template <typename T>
+bool ReversedTest(const int N, const string& Path) {
+    vector<T> S(N), E(N);
+    for (int j = 0; j < N; ++j) {
+        S[j] = rand() % 1000;
+        E[j] = S[j] + rand() % 100 - 33;
+    }
+    // The smallest case that used to corrupt the build
+    S[0] = 10, E[0] = 5, S[1] = 0, E[1] = 5;
+    RangeMap<T> rm[4];
+    rm[1].SetLayout(SearchLayout::Eytzinger);
+    rm[2].SetLayout(SearchLayout::STree);
+    rm[3].SetThreads(4);
+    for (RangeMap<T>& r : rm)
+        r.Build(S.data(), E.data(), N);
+    DeltaRangeMap<T> dm;
+    dm.Build(S.data(), E.data(), N);
+    vector<size_t> Out;
+    for (int p = -200; p < 1200; ++p) {
+        auto s = SlowCheck<T>(T(p), S.data(), E.data(), N);
+        for (RangeMap<T>& r : rm) {
+            if (!Same(r.Query(T(p)), s))
+                return false;
+        }
+        dm.Query(T(p), Out);
+        if (Out != s)
+            return false;
+    }
+    RangeMapFileBuilder<T> fb(Path + ".ext", 4096);
+    for (int j = 0; j < N; ++j)
+        fb.Add(S[j], E[j]);
+    const bool Ok = fb.Finish() && MappedRangeMap<T>::Save(rm[0], (Path + ".mem").c_str()) &&
+                    (ReadFile((Path + ".ext").c_str()) == ReadFile((Path + ".mem").c_str()));
+    remove((Path + ".ext").c_str());
+    remove((Path + ".mem").c_str());
+    return Ok;
+}
+
+/* Checks window queries against the brute force approach
+ * N:   Number of intervals
+ * M:   Number of windows */
+template <typename T, typename I = size_t>
+bool RangeTest(const int N, const int M) {
+    vector<T> S, E;
+    UniformData(N, 10000, 150, S, E);
+    RangeMap<T, I> rm;
+    rm.SetWindowQueries(true);
+    rm.Build(S.data(), E.data(), N);
+    vector<I> R(N);
+    for (int k = 0; k < M; ++k) {
+        const T lo = rand() % 10500 - 100;
+        const T hi = lo + rand() % 500 - 10;
+        vector<size_t> s2;
+        for (int i = 0; i < N; ++i) {
+            if ((S[i] != E[i]) && (S[i] < hi) && (lo < E[i]) && (lo < hi))
+                s2.push_back(i);
+        }
+        // A buffer that is too small reports the size needed
+        const size_t n = rm.QueryRange(lo, hi, R.data(), s2.size() / 2);
+        if ((n != s2.size()) || (rm.QueryRange(lo, hi, R.data(), R.size()) != n))
+            return false;
+        vector<size_t> s1(R.begin(), R.begin() + n);
+        sort(s1.begin(), s1.end());
+        if (s1 != s2)
+            return false;
+    }
+    // Count-only and empty maps report nothing
+    RangeMap<T, I> rc, re;
+    rc.SetWindowQueries(true);
+    rc.SetCountOnly(true);
+    rc.Build(S.data(), E.data(), N);
+    bool Ok = (rc.QueryRange(T(0), T(10000), R.data(), R.size()) == 0) && (re.QueryRange(T(0), T(10000), R.data(), R.size()) == 0);
+#ifdef NDEBUG
+    // Maps built without window queries assert, and report nothing once asserts are disabled
+    RangeMap<T, I> rn;
+    rn.Build(S.data(), E.data(), N);
+    rn.SetWindowQueries(true);      // Only takes effect at the next Build
+    Ok = Ok && (rn.QueryRange(T(0), T(10000), R.data(), R.size()) == 0);
+#endif
+    return Ok;
+}
+
+// Memory resource that counts the bytes it has outstanding
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t Bytes = 0, Calls = 0;
+
+private:
+    void* do_allocate(size_t n, size_t a) override {
+        Bytes += n;
+        ++Calls;
+        return std::pmr::new_delete_resource()->allocate(n, a);
+    }
+    void do_deallocate(void* p, size_t n, size_t a) override {
+        Bytes -= n;
+        std::pmr::new_delete_resource()->deallocate(p, n, a);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override {
+        return this == &o;
+    }
+};
+
+/* Checks that maps built with a memory resource allocate from it and answer
+ * queries like maps using the default allocator
+ * N:   Number of intervals */
+template <typename T>
+bool ResourceTest(const int N) {
+    vector<T> S, E;
+    UniformData(N, 100000, 150, S, E);
+    RangeMap<T> rm;
+    rm.Build(S.data(), E.data(), N);
+    CountingResource Counter;
+    bool Ok = true;
+    {
+        std::pmr::monotonic_buffer_resource Arena(&Counter);
+        RangeMap<T> ra(&Arena), rc(&Counter);
+        ra.SetLayout(SearchLayout::STree);
+        rc.SetThreads(4);
+        ra.Build(S.data(), E.data(), N);
+        rc.Build(S.data(), E.data(), N);
+        for (int j = 0; j < N; ++j) {
+            auto s1 = rm.Query(S[j]);
+            vector<size_t> s2(s1.begin(), s1.end());
+            Ok = Ok && Same(ra.Query(S[j]), s2) && Same(rc.Query(S[j]), s2);
+        }
+        Ok = Ok && (Counter.Calls > 0);
+    }
+    return Ok && (Counter.Bytes == 0);
+}
+
+/* Checks that rebuilding with a BuildContext does not allocate once buffers have grown
+ * N:   Number of intervals */
+template <typename T>
+bool RebuildTest(const int N) {
+    vector<T> S1, E1, S2, E2;
+    UniformData(N, 100000, 150, S1, E1);
+    UniformData(N, 1000, 15, S2, E2);
+    typename RangeMap<T>::BuildContext C;
+    RangeMap<T> rm, re;
+    re.SetLayout(SearchLayout::STree);
+    for (int k = 0; k < 2; ++k) {   // Grow every buffer to fit both inputs
+        rm.Build(S1.data(), E1.data(), N, C);
+        rm.Build(S2.data(), E2.data(), N, C);
+        re.Build(S1.data(), E1.data(), N, C);
+        re.Build(S2.data(), E2.data(), N, C);
+    }
+    const size_t Before = NewCalls;
+    for (int k = 0; k < 10; ++k) {
+        rm.Build(S1.data(), E1.data(), N, C);
+        re.Build(S2.data(), E2.data(), N / 2, C);
+    }
+    const size_t After = NewCalls;
+    // The result matches a fresh build
+    RangeMap<T> rf;
+    rf.Build(S1.data(), E1.data(), N);
+    for (int j = 0; j < N; ++j) {
+        auto s1 = rf.Query(S1[j]);
+        if (!Same(rm.Query(S1[j]), vector<size_t>(s1.begin(), s1.end())))
+            return false;
+    }
+    return (After == Before) && (rm.Stats().BuildAllocs == 0) && (re.Stats().BuildAllocs == 0) && (rf.Stats().BuildAllocs > 0);
+}
+
+/* Checks the statistics reported by Stats against counts at every breakpoint
+ * N:   Number of intervals */
+template <typename T>
+bool StatsTest(const int N) {
+    vector<T> S, E;
+    UniformData(N, 10000, 150, S, E);
+    // The breakpoints are the distinct endpoints of non-empty intervals plus both sentinels
+    vector<T> B{numeric_limits<T>::lowest(), numeric_limits<T>::max()};
+    for (int j = 0; j < N; ++j) {
+        if (S[j] != E[j]) {
+            B.push_back(S[j]);
+            B.push_back(E[j]);
+        }
+    }
+    sort(B.begin(), B.end());
+    B.erase(unique(B.begin(), B.end()), B.end());
+    size_t Entries = 0, MaxActive = 0;
+    for (const T& b : B) {
+        const size_t c = SlowCheck<T>(b, S.data(), E.data(), N).size();
+        Entries += c;
+        MaxActive = max(MaxActive, c);
+    }
+    RangeMap<T> rm, rc;
+    rm.SetLayout(SearchLayout::Eytzinger);
+    rc.SetCountOnly(true);
+    rm.Build(S.data(), E.data(), N);
+    rc.Build(S.data(), E.data(), N);
+    const RangeMapStats a = rm.Stats(), c = rc.Stats();
+    // Every allocation of a serial or parallel build is counted, including temporary buffers
+    vector<T> SL, EL;
+    UniformData(4 * RMImpl::PAR_MIN, 100000, 150, SL, EL);
+    bool Ok = true;
+    for (size_t P : {1, 4}) {
+        CountingResource Counter;
+        RangeMap<T> rt(&Counter);
+        rt.SetThreads(P);
+        rt.SetWindowQueries(true);
+        rt.SetLayout(SearchLayout::Eytzinger);
+        for (int k = 0; k < 2; ++k) {
+            const size_t Before = Counter.Calls;
+            rt.Build(SL.data(), EL.data(), SL.size());
+            Ok = Ok && (rt.Stats().BuildAllocs == Counter.Calls - Before);
+        }
+    }
+    return Ok && (a.Breakpoints == B.size()) && (a.Entries == Entries) && (a.MaxActive == MaxActive) &&
+           (a.MeanActive == double(Entries) / B.size()) && (a.TabBytes >= B.size() * sizeof(T)) &&
+           (a.IndexBytes >= Entries * sizeof(size_t)) && (a.LayoutBytes > 0) && (a.BuildAllocs > 0) &&
+           (a.TotalBytes >= a.TabBytes + a.IndexBytes + a.LayoutBytes) && (c.Entries == Entries) &&
+           (c.MaxActive == MaxActive) && (c.IndexBytes < Entries * sizeof(size_t)) && (c.LayoutBytes == 0) &&
+           (c.TotalBytes == c.TabBytes + c.IndexBytes) && (a.TotalBytes == a.TabBytes + a.IndexBytes + a.LayoutBytes) &&
+           (RangeMap<T>().Stats().TotalBytes == 0);
+}
+
+/* Checks FindSlot against std::upper_bound for tables of every size up to N with
+ * repeated values, and for points below, between, on and above the breakpoints
+ * N:   Largest table size */
+template <typename T>
+bool SearchTest(const size_t N) {
+    for (size_t n = 0; n <= N; ++n) {
+        vector<T> t(n);
+        for (size_t i = 0; i < n; ++i)
+            t[i] = T(2 * (i - i % 3));      // Every value three times
+        for (T p = T(-3); p < T(2 * n + 3); p = p + T(1)) {
+            if (RMImpl::FindSlot(t.data(), n, p) != size_t(upper_bound(t.begin(), t.end(), p) - t.begin()) - 1)
                 return false;
         }
     }
+    // Types that are not arithmetic take the std::upper_bound path
+    vector<string> w{"b", "d", "f"};
+    return (RMImpl::FindSlot(w.data(), w.size(), string("a")) == numeric_limits<size_t>::max()) &&
+           (RMImpl::FindSlot(w.data(), w.size(), string("d")) == 1) && (RMImpl::FindSlot(w.data(), w.size(), string("z")) == 2);
+}
+
+// Probes keep no state in the map, and the default map is the uninstrumented one
+static_assert(std::is_same<RangeMap<int>, RangeMap<int, size_t, NoProbe> >::value, "NoProbe must be the default");
+static_assert(sizeof(RangeMap<int, size_t, CountingProbe<> >) == sizeof(RangeMap<int>), "Probes must not add state to the map");
+
+/* Checks the counts recorded by CountingProbe from several threads in every layout
+ * N:   Number of intervals
+ * M:   Number of queries per thread */
+template <typename T>
+bool ProbeTest(const int N, const int M) {
+    struct Tag;
+    typedef CountingProbe<Tag> Probe;
+    vector<T> S, E, Q;
+    UniformData(N, 100000, 500, S, E);
+    RMGen::Params P;
+    P.Seed = rand();
+    P.Range = 101000;
+    RMGen::Queries(RMGen::Points::Uniform, M, P, S, E, Q);
+    bool Ok = true;
+    for (SearchLayout L : {SearchLayout::Sorted, SearchLayout::Eytzinger, SearchLayout::STree}) {
+        RangeMap<T> rm;
+        RangeMap<T, size_t, Probe> rp;
+        rm.SetLayout(L);
+        rp.SetLayout(L);
+        rm.Build(S.data(), E.data(), N);
+        const ProbeCounts Before = Probe::Read();
+        rp.Build(S.data(), E.data(), N);
+        size_t Results = 0;
+        for (const T& q : Q)
+            Results += rm.Count(q);
+        // Query from two threads, one of which exits before the counts are read
+        bool OtherOk = true;
+        thread Other([&]() {
+            for (const T& q : Q)
+                OtherOk = OtherOk && (rp.Count(q) == rm.Count(q));
+        });
+        for (const T& q : Q)
+            Ok = Ok && Same(rp.Query(q), vector<size_t>(rm.Query(q).begin(), rm.Query(q).end()));
+        Other.join();
+        Ok = Ok && OtherOk;
+        const ProbeCounts After = Probe::Read();
+        uint64_t Depths = 0, Ns = 0;
+        for (size_t d = 0; d < ProbeCounts::DEPTHS; ++d)
+            Depths += After.Depth[d] - Before.Depth[d];
+        for (size_t h = 0; h < ProbeCounts::PHASES; ++h)
+            Ns += After.PhaseNs[h] - Before.PhaseNs[h];
+        const size_t Steps = RMImpl::SearchSteps(rp.Stats().Breakpoints);
+        Ok = Ok && (After.Queries - Before.Queries == 2 * size_t(M)) && (After.Results - Before.Results == 2 * Results) &&
+             (Depths == 2 * size_t(M)) && (After.Builds - Before.Builds == 1) && (Ns > 0) &&
+             ((L != SearchLayout::Sorted) || (After.Depth[Steps] - Before.Depth[Steps] == 2 * size_t(M)));
+    }
+    // Neither the default nor a recording probe adds state to the map
+    return Ok && (sizeof(RangeMap<T>) == sizeof(RangeMap<T, size_t, NoProbe>)) && (sizeof(RangeMap<T, size_t, Probe>) == sizeof(RangeMap<T>));
+}
+
+/* Checks maps storing narrower interval indices against the default map, in memory and on disk
+ * N:       Number of intervals; at most 65536
+ * Path:    Scratch file prefix */
+template <typename T, typename I>
+bool WidthTest(const int N, const string& Path) {
+    vector<T> S, E;
+    UniformData(N, 100000, 250, S, E);
+    RangeMap<T> rm;
+    RangeMap<T, I> rn;
+    rm.Build(S.data(), E.data(), N);
+    rn.Build(S.data(), E.data(), N);
+    vector<size_t> ROff(N + 1);
+    vector<I> RIdx(rn.QueryBatch(S.data(), N, ROff.data(), nullptr, 0));
+    rn.QueryBatch(S.data(), N, ROff.data(), RIdx.data(), RIdx.size());
+    for (int j = 0; j < N; ++j) {
+        auto s1 = rm.Query(S[j]);
+        vector<size_t> s2(s1.begin(), s1.end());
+        if (!Same(rn.Query(S[j]), s2) || !equal(RIdx.begin() + ROff[j], RIdx.begin() + ROff[j + 1], s2.begin(), s2.end()))
+            return false;
+    }
+    // Files record the index width
+    RangeMapFileBuilder<T, I> fb(Path + ".ext", 4096);
+    for (int j = 0; j < N; ++j)
+        fb.Add(S[j], E[j]);
+    MappedRangeMap<T, I> mn;
+    MappedRangeMap<T> mm;
+    bool Ok = fb.Finish() && MappedRangeMap<T, I>::Save(rn, (Path + ".mem").c_str()) &&
+              (ReadFile((Path + ".ext").c_str()) == ReadFile((Path + ".mem").c_str())) &&
+              mn.Open((Path + ".mem").c_str()) && !mm.Open((Path + ".mem").c_str());
+    for (int j = 0; Ok && j < N; ++j) {
+        auto s1 = rm.Query(E[j]);
+        Ok = Same(mn.Query(E[j]), vector<size_t>(s1.begin(), s1.end()));
+    }
+    mn.Close();
+    remove((Path + ".ext").c_str());
+    remove((Path + ".mem").c_str());
+    return Ok;
+}
+
+/* Checks that maps and file builders refuse more intervals than their index type can hold
+ * N:       Number of unit intervals; more than the largest I plus one
+ * Path:    Scratch file prefix */
+template <typename T, typename I>
+bool WrapTest(const size_t N, const string& Path) {
+    const size_t L = size_t(numeric_limits<I>::max()) + 1;     // Most intervals I can index
+    vector<T> S(N), E(N);
+    for (size_t j = 0; j < N; ++j) {
+        S[j] = T(j);
+        E[j] = T(j + 1);
+    }
+    RangeMap<T, I> rn;
+    AtomicRangeMap<T, I> am;
+    bool Ok = rn.Build(S.data(), E.data(), 100) && !rn.Build(S.data(), E.data(), N) && !am.Build(S.data(), E.data(), N) &&
+              (rn.Stats().Breakpoints == 103) && Same(rn.Query(T(50)), vector<size_t>{50}) && (rn.Count(T(L)) == 0);
+    typename AtomicRangeMap<T, I>::Reader rd(am);
+    Ok = Ok && (rd.Lock()->Stats().Breakpoints == 0);
+    // The builder keeps the intervals it could index and refuses the rest
+    RangeMapFileBuilder<T, I> fb(Path + ".ext", 4096);
+    for (size_t j = 0; j < N; ++j)
+        Ok = Ok && (fb.Add(S[j], E[j]) == (j < L));
+    MappedRangeMap<T, I> mn;
+    Ok = Ok && fb.Finish() && mn.Open((Path + ".ext").c_str()) && Same(mn.Query(T(L - 1)), vector<size_t>{L - 1}) &&
+         (mn.Count(T(L)) == 0);
+    mn.Close();
+    remove((Path + ".ext").c_str());
+    return Ok && rn.Build(S.data(), E.data(), L) && Same(rn.Query(T(L - 1)), vector<size_t>{L - 1});
+}
+
+/* Checks every search layout and DeltaRangeMap against the brute force approach on
+ * each generated interval shape and query distribution, and checks that the
+ * generators are deterministic
+ * N:   Number of intervals
+ * M:   Number of queries per distribution */
+template <typename T>
+bool ShapeTest(const size_t N, const size_t M) {
+    using RMGen::Shape;
+    using RMGen::Points;
+    RMGen::Params P;
+    P.Seed = rand();
+    P.Range = 100000;
+    P.Length = 2000;
+    P.Depth = 16;
+    P.Hot = 8;
+    for (Shape Sh : {Shape::Uniform, Shape::Nested, Shape::Disjoint, Shape::Chained, Shape::Clustered, Shape::PowerLaw}) {
+        vector<T> S, E, S2, E2;
+        RMGen::Intervals(Sh, N, P, S, E);
+        RMGen::Intervals(Sh, N, P, S2, E2);
+        if (S != S2 || E != E2)
+            return false;
+        RangeMap<T> rm[3];
+        const SearchLayout L[] = {SearchLayout::Sorted, SearchLayout::Eytzinger, SearchLayout::STree};
+        for (int l = 0; l < 3; ++l) {
+            rm[l].SetLayout(L[l]);
+            rm[l].Build(S.data(), E.data(), N);
+        }
+        DeltaRangeMap<T> dm;
+        dm.Build(S.data(), E.data(), N);
+        vector<size_t> Out;
+        for (Points Pt : {Points::Uniform, Points::Sorted, Points::Zipf, Points::Endpoints}) {
+            vector<T> Q;
+            RMGen::Queries(Pt, M, P, S, E, Q);
+            for (const T& q : Q) {
+                auto s = SlowCheck<T>(q, S.data(), E.data(), N);
+                for (int l = 0; l < 3; ++l) {
+                    if (!Same(rm[l].Query(q), s) || rm[l].Count(q) != s.size())
+                        return false;
+                }
+                dm.Query(q, Out);
+                if (Out != s)
+                    return false;
+            }
+        }
+    }
     return true;
 }
 
@@ -112,7 +1007,6 @@ int main() {
     const int MAXA = 1000;
     const int nt = 333;
     bool rv;
-    std::chrono::duration<double> tSum1, tSum2;
     srand(time(nullptr));
 
     cout << "Test Count: " << nt << endl;
@@ -120,6 +1014,41 @@ int main() {
     RUN_TEST(int);
     RUN_TEST(double);
     RUN_TEST(unsigned int);
+    RUN_TEST(float);
+    RUN_TEST(long);
+    cout << "Test:    Search" << endl << "Result:  " << (SearchTest<int>(200) && SearchTest<double>(200) && SearchTest<float>(70) &&
+        SearchTest<long>(70) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Reversed" << endl << "Result:  " << (ReversedTest<int>(2000, "RMTest") && ReversedTest<double>(100000, "RMTest") ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Window" << endl << "Result:  " << (RangeTest<int>(2000, 2000) && RangeTest<double>(2000, 2000) &&
+        RangeTest<int, uint16_t>(2000, 2000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Cursor" << endl << "Result:  " << (CursorTest<int>(20000, 100000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Radix" << endl << "Result:  " << (RadixTest<int>(10000) && RadixTest<long>(10000) &&
+        RadixTest<unsigned int>(10000) && RadixTest<float>(10000) && RadixTest<double>(10000) &&
+        RadixTest<int>(5 * RMImpl::PAR_MIN + 7, 4) && RadixTest<double>(3 * RMImpl::PAR_MIN, 3) ? "PASS" : "FAIL") << endl;
+    DynRangeMap<int> dmi;
+    DynRangeMap<double> dmd;
+    cout << "Test:    Dynamic" << endl << "Result:  " << (DynTest<int>(300, 20000, dmi) && DynTest<double>(300, 20000, dmd) ? "PASS" : "FAIL") << endl;
+    LogRangeMap<int> lmi(8, 2);
+    LogRangeMap<double> lmd(16, 3);
+    cout << "Test:    Log-structured" << endl << "Result:  " << (DynTest<int>(300, 20000, lmi) && DynTest<double>(300, 20000, lmd) &&
+        EraseOnlyTest(5000) && LogReadTest(2000, 20000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Parallel" << endl << "Result:  " << (ParallelTest<int>(100000, 4) && ParallelTest<int>(300000, 8) &&
+        // long double is too wide for the radix sort, so this covers the parallel comparison sort
+        ParallelTest<long double>(4 * RMImpl::PAR_MIN + 999, 8) && ParallelTest<long double>(2 * RMImpl::PAR_MIN + 1, 3) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Resource" << endl << "Result:  " << (ResourceTest<int>(100000) && ResourceTest<double>(1000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Rebuild" << endl << "Result:  " << (RebuildTest<int>(50000) && RebuildTest<double>(1000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Stats" << endl << "Result:  " << (StatsTest<int>(3000) && StatsTest<double>(3000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Probe" << endl << "Result:  " << (ProbeTest<int>(20000, 20000) && ProbeTest<double>(3000, 5000) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    File" << endl << "Result:  " << (FileTest<int>(20000, "RMTest.rmap") && FileTest<double>(20000, "RMTest.rmap") &&
+        FileTest<float>(3, "RMTest.rmap") ? "PASS" : "FAIL") << endl;
+    cout << "Test:    External" << endl << "Result:  " << (ExternalTest<int>(20000, 4096, "RMTest") && ExternalTest<double>(20000, 1 << 20, "RMTest") &&
+        ExternalTest<float>(3000, 4096, "RMTest") && ExternalTest<long>(1, 64, "RMTest") && ExternalTest<int>(0, 64, "RMTest") && ManyRunsTest("RMTest") ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Index width" << endl << "Result:  " << (WidthTest<int, uint32_t>(20000, "RMTest") && WidthTest<double, uint16_t>(65536, "RMTest") &&
+        WidthTest<unsigned int, uint16_t>(1000, "RMTest") && WrapTest<int, uint16_t>(70000, "RMTest") &&
+        WrapTest<double, uint8_t>(300, "RMTest") ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Shapes" << endl << "Result:  " << (ShapeTest<int>(2000, 500) && ShapeTest<double>(2000, 500) &&
+        ShapeTest<long>(1, 10) ? "PASS" : "FAIL") << endl;
+    cout << "Test:    Snapshot" << endl << "Result:  " << (SnapshotTest(2000, 300, 4) && ReadersTest(3) ? "PASS" : "FAIL") << endl;
 
     return 0;
 }
\ No newline at end of file
@@ -6,99 +6,1316 @@
 #ifndef RANGE_MAP_H
 #define RANGE_MAP_H
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <limits>
+#include <memory_resource>
 #include <numeric>
-#include <set>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 // Macro to help ensure pre-allocation sizes are correct
 #define PUSHBACK(X, Y) assert(X.capacity() > X.size()); X.push_back(Y)
 // Hack to get -std::numeric_limits<T>::infinity() to compile for integral types
 #define NEG_INFTY ((1 - 2 * std::numeric_limits<T>::has_infinity) * std::numeric_limits<T>::infinity())
 #define POS_INFTY std::numeric_limits<T>::infinity()
+// Hint to bring the cache line containing P into cache
+#if defined(__GNUC__) || defined(__clang__)
+#define RM_PREFETCH(P) __builtin_prefetch(P)
+#else
+#define RM_PREFETCH(P)
+#endif
 
-/* Class for solving the following problem:
- * Given a list L of intervals of the form [a, b) and a point p,
- * determine the set of all intervals in L that contain p. */
-template <typename T>
-class RangeMap {
-    std::vector<T> Tab;                         // Internal table for searching intervals
-    std::vector<std::vector<size_t> > IList;    // Internal list containing sets
-    const std::vector<size_t> Empty;            // Convenience member for returning empty sets
+// Layout of the breakpoint table used by RangeMap::Query
+enum class SearchLayout {
+    Sorted,     // Plain sorted array searched by binary search (default)
+    Eytzinger,  // Breadth-first (Eytzinger) order with prefetching; better for large maps
+    STree       // Static B-tree with 16 keys per node compared using SIMD; best for very large maps
+};
 
-public:
-    /* Builds the RangeMap from a list of intervals like [a, b)
-     * S:   An array of interval starting values
-     * E:   An array of interval closing values
-     * N:   The number of elements in S and E */
-    void Build(const T* S, const T* E, const size_t N) {
-        if (nullptr == S || nullptr == E || N == 0)
+// Phases of RangeMap::Build timed by an instrumentation policy
+enum class BuildPhase {
+    ArgSort,        // Sorting intervals by starting and closing value
+    Sweep,          // Recording the breakpoints and the size of each active set
+    Materialize     // Filling the index lists and building the search layout
+};
+
+/* Instrumentation policy of RangeMap that records nothing. A policy is a type with
+ * these static members, which RangeMap calls from Query, Count and Build:
+ *   Enabled:           False if the hooks record nothing; RangeMap then skips the
+ *                      work of computing their arguments
+ *   Query(d, k):       After a search taking d steps that found k intervals
+ *   Clock():           The current time in ns, read when Build starts
+ *   Phase(ph, t):      When build phase ph, begun at time t, ends; returns the current time
+ * RangeMap only calls Query when Enabled is true, so these hooks cost nothing on
+ * the query path. See RangeMapProbe.h for one that records. */
+struct NoProbe {
+    static constexpr bool Enabled = false;
+    static void Query(unsigned, size_t) { }
+    static uint64_t Clock() { return 0; }
+    static uint64_t Phase(BuildPhase, uint64_t) { return 0; }
+};
+
+// Size and shape of a built RangeMap, as returned by RangeMap::Stats
+struct RangeMapStats {
+    size_t Breakpoints = 0;     // Entries of the breakpoint table, including the -inf and +inf sentinels
+    size_t Entries = 0;         // Interval indices over all breakpoints; counted even when count-only
+    size_t MaxActive = 0;       // Most intervals containing any one point
+    double MeanActive = 0;      // Mean number of intervals active at a breakpoint
+    size_t TabBytes = 0;        // Bytes held by the breakpoint table
+    size_t IndexBytes = 0;      // Bytes held by the offsets and the index lists
+    size_t LayoutBytes = 0;     // Bytes held by the Eytzinger or S-tree layout
+    size_t TotalBytes = 0;      // Bytes held by the map, including what Build keeps for QueryRange
+    size_t BuildAllocs = 0;     // Buffers the last Build allocated or grew, including temporary ones
+};
+
+namespace RMImpl {
+    // Minimum amount of work given to each thread in a parallel build
+    constexpr size_t PAR_MIN = 1 << 15;
+
+    /* Runs F(t) for each t in [b, e), each on its own thread; F(b) runs on the calling
+     * thread. Each call starts one thread for the upper half of the range and recurses,
+     * so no list of threads is allocated. */
+    template <typename Fn>
+    void ParallelRange(const size_t b, const size_t e, const Fn& F) {
+        if (e - b > 1) {
+            const size_t m = b + (e - b) / 2;
+            std::thread h([&F, m, e]() { ParallelRange(m, e, F); });
+            ParallelRange(b, m, F);
+            h.join();
+        }
+        else if (e > b)
+            F(b);
+    }
+
+    /* Runs F(t) for each t in [0, P), each on its own thread; F(0) runs on the calling thread
+     * P:   Number of threads
+     * F:   The function to run */
+    template <typename Fn>
+    void ParallelFor(const size_t P, Fn F) {
+        ParallelRange(0, P, F);
+    }
+
+    // Memory resource that forwards to another and counts the allocations made through it
+    class CountingResource : public std::pmr::memory_resource {
+        std::pmr::memory_resource* Up;
+
+        void* do_allocate(size_t n, size_t a) override {
+            ++Allocs;
+            return Up->allocate(n, a);
+        }
+
+        void do_deallocate(void* p, size_t n, size_t a) override {
+            Up->deallocate(p, n, a);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override {
+            return this == &o;
+        }
+
+    public:
+        size_t Allocs = 0;  // Allocations so far
+
+        explicit CountingResource(std::pmr::memory_resource* Up) : Up(Up) { }
+    };
+
+    /* Sorts a vector using up to P threads by sorting chunks and merging them pairwise
+     * V:       The vector to sort
+     * C:       Comparison function; must be a strict total order for the result to not depend on P
+     * P:       Maximum number of threads
+     * Tmp:     Scratch space; must hold at least V.size() elements when P > 1 */
+    template <typename Vec, typename Cmp>
+    void ParallelSort(Vec& V, Cmp C, size_t P, std::pmr::vector<typename Vec::value_type>& Tmp) {
+        const size_t n = V.size();
+        P = std::max<size_t>(1, std::min(P, n / PAR_MIN));
+        if (P == 1) {
+            std::sort(V.begin(), V.end(), C);
             return;
-        // Argsort filtering any empty intervals
-        std::vector<size_t> SS;
-        std::vector<size_t> SE;
+        }
+        assert(Tmp.size() >= n);
+        auto* Src = V.data();
+        auto* Dst = Tmp.data();
+        auto Bound = [n, P](size_t t) { return n * t / P; };
+        ParallelFor(P, [&](size_t t) { std::sort(Src + Bound(t), Src + Bound(t + 1), C); });
+        for (size_t W = 1; W < P; W *= 2) {
+            ParallelFor((P + 2 * W - 1) / (2 * W), [&](size_t t) {
+                const size_t a = 2 * W * t, m = std::min(a + W, P), e = std::min(a + 2 * W, P);
+                std::merge(Src + Bound(a), Src + Bound(m), Src + Bound(m), Src + Bound(e), Dst + Bound(a), C);
+            });
+            std::swap(Src, Dst);
+        }
+        if (Src != V.data())
+            std::copy(Src, Src + n, V.data());
+    }
+
+    // v with -0 replaced by 0, so equal breakpoints are stored with the same bits
+    template <typename T>
+    inline T PositiveZero(const T& v) {
+        if constexpr (std::is_floating_point<T>::value)
+            return (v == T(0)) ? T(0) : v;
+        else
+            return v;
+    }
+
+    /* Maps an arithmetic value to an unsigned key with the same ordering: the sign
+     * bit of signed integers is flipped, and for IEEE-754 floating point negative
+     * values have all bits flipped and positive values the sign bit set */
+    template <typename T>
+    inline typename std::conditional<(sizeof(T) > 4), uint64_t, uint32_t>::type RadixKey(T v) {
+        typedef typename std::conditional<(sizeof(T) > 4), uint64_t, uint32_t>::type K;
+        constexpr K SIGN = K(1) << (8 * sizeof(T) - 1);
+        if constexpr (std::is_floating_point<T>::value) {
+            static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Unsupported floating point type");
+            v = PositiveZero(v);    // -0 and 0 compare equal
+            K b;
+            std::memcpy(&b, &v, sizeof(T));
+            return (b & SIGN) ? ~b : (b | SIGN);
+        }
+        else if constexpr (std::is_signed<T>::value)
+            return K(typename std::make_unsigned<T>::type(v)) ^ SIGN;
+        else
+            return K(v);
+    }
+
+    // The value mapped to a key by RadixKey; -0 comes back as 0
+    template <typename T, typename K>
+    inline T FromRadixKey(K k) {
+        constexpr K SIGN = K(1) << (8 * sizeof(T) - 1);
+        if constexpr (std::is_floating_point<T>::value) {
+            k = (k & SIGN) ? (k ^ SIGN) : ~k;
+            T v;
+            std::memcpy(&v, &k, sizeof(T));
+            return v;
+        }
+        else if constexpr (std::is_signed<T>::value)
+            return T(typename std::make_unsigned<T>::type(k ^ SIGN));
+        else
+            return T(k);
+    }
+
+    // Whether SortIndices uses the radix sort for T
+    template <typename T>
+    constexpr bool UseRadix() {
+        return std::is_arithmetic<T>::value && !std::is_same<T, bool>::value && sizeof(T) <= 8;
+    }
+
+    /* Scratch space for sorting interval indices. Reusing it across sorts avoids
+     * allocating once its buffers have grown to fit. */
+    template <typename T>
+    struct SortScratch {
+        typedef typename std::conditional<(sizeof(T) > 4), uint64_t, uint32_t>::type Key;
+        struct KeyIndex { Key K; size_t I; };
+
+        std::pmr::vector<KeyIndex> A, B;    // Radix sort buffers
+        std::pmr::vector<size_t> H;         // Radix sort histograms of each digit for each thread
+        std::pmr::vector<size_t> Tmp;       // Merge buffer of the parallel comparison sort
+        std::pmr::vector<T> V;              // The sorted values, so later passes read them in order
+
+        explicit SortScratch(std::pmr::memory_resource* R = std::pmr::get_default_resource()) : A(R), B(R), H(R), Tmp(R), V(R) { }
+
+        // Sizes the buffers for sorting n indices with up to P threads so no sort allocates
+        void Fit(size_t n, size_t P = 1) {
+            if constexpr (UseRadix<T>()) {
+                A.resize(n);
+                B.resize(n);
+                H.resize(std::max<size_t>(1, P) * sizeof(T) * 256);
+            }
+            else
+                Tmp.resize(n);
+            V.resize(n);
+        }
+    };
+
+    /* Stable LSD radix sort of interval indices by an arithmetic key using 8 bit
+     * digits. Digits that are the same for every key are skipped. With more than
+     * one thread each pass is split into chunks: every chunk counts its digits,
+     * the counts are prefix-summed bucket by bucket over the chunks, and every
+     * chunk then scatters its keys, so the result does not depend on P.
+     * V:   Values to sort by
+     * Ix:  Indices into V to sort; ties keep their order
+     * P:   Maximum number of threads
+     * W:   Scratch space; W.V receives the sorted values */
+    template <typename T, typename Vec>
+    void RadixSortIndices(const T* V, Vec& Ix, size_t P, SortScratch<T>& W) {
+        typedef typename SortScratch<T>::KeyIndex KeyIndex;
+        constexpr size_t D = sizeof(T);     // Number of digits
+        const size_t n = Ix.size();
+        P = std::max<size_t>(1, std::min(P, n / PAR_MIN));
+        W.Fit(n, P);
+        std::fill(W.H.begin(), W.H.end(), 0);
+        auto& A = W.A;
+        auto& B = W.B;
+        auto Chunk = [n, P](size_t t) { return n * t / P; };
+        // Histogram of digit d for chunk t
+        auto Hist = [&W](size_t t, size_t d) { return W.H.data() + (t * D + d) * 256; };
+        ParallelFor(P, [&](size_t t) {
+            for (size_t i = Chunk(t); i < Chunk(t + 1); ++i) {
+                A[i] = KeyIndex{RadixKey(V[Ix[i]]), Ix[i]};
+                for (size_t d = 0; d < D; ++d)
+                    ++Hist(t, d)[(A[i].K >> (8 * d)) & 0xFF];
+            }
+        });
+        bool Moved = false;     // Whether A is no longer in input order, so chunk counts must be redone
+        for (size_t d = 0; d < D; ++d) {
+            // A digit is the same for every key if one bucket holds all of them
+            size_t First = 0;
+            for (size_t t = 0; t < P; ++t)
+                First += (n == 0) ? 0 : Hist(t, d)[(A[0].K >> (8 * d)) & 0xFF];
+            if (n == 0 || First == n)
+                continue;
+            if (Moved && (P > 1)) {
+                ParallelFor(P, [&](size_t t) {
+                    size_t* Ht = Hist(t, d);
+                    std::fill(Ht, Ht + 256, 0);
+                    for (size_t i = Chunk(t); i < Chunk(t + 1); ++i)
+                        ++Ht[(A[i].K >> (8 * d)) & 0xFF];
+                });
+            }
+            // Exclusive prefix sum gives where each chunk writes into each bucket
+            for (size_t j = 0, Sum = 0; j < 256; ++j) {
+                for (size_t t = 0; t < P; ++t) {
+                    const size_t c = Hist(t, d)[j];
+                    Hist(t, d)[j] = Sum;
+                    Sum += c;
+                }
+            }
+            ParallelFor(P, [&](size_t t) {
+                size_t* Ht = Hist(t, d);
+                for (size_t i = Chunk(t); i < Chunk(t + 1); ++i)
+                    B[Ht[(A[i].K >> (8 * d)) & 0xFF]++] = A[i];
+            });
+            A.swap(B);
+            Moved = true;
+        }
+        ParallelFor(P, [&](size_t t) {
+            for (size_t i = Chunk(t); i < Chunk(t + 1); ++i) {
+                Ix[i] = A[i].I;
+                W.V[i] = FromRadixKey<T>(A[i].K);
+            }
+        });
+    }
+
+    // Single-threaded radix sort with temporary scratch space
+    template <typename T, typename Vec>
+    void RadixSortIndices(const T* V, Vec& Ix) {
+        SortScratch<T> W;
+        RadixSortIndices(V, Ix, 1, W);
+    }
+
+    /* Sorts interval indices by value, breaking ties by index. Uses radix sort for
+     * arithmetic types and a parallel comparison sort otherwise.
+     * V:   Values to sort by
+     * Ix:  Indices into V in increasing order
+     * P:   Maximum number of threads
+     * W:   Scratch space; must already fit Ix when P > 1. W.V receives the sorted values */
+    template <typename T, typename Vec>
+    void SortIndices(const T* V, Vec& Ix, size_t P, SortScratch<T>& W) {
+        if constexpr (UseRadix<T>())
+            RadixSortIndices(V, Ix, P, W);
+        else {
+            ParallelSort(Ix, [&V](size_t i1, size_t i2) { return (V[i1] < V[i2]) || (!(V[i2] < V[i1]) && (i1 < i2)); }, P, W.Tmp);
+            W.V.resize(Ix.size());
+            const size_t n = Ix.size();
+            const size_t PG = std::max<size_t>(1, std::min(P, n / PAR_MIN));
+            ParallelFor(PG, [&](size_t t) {
+                for (size_t i = n * t / PG; i < n * (t + 1) / PG; ++i)
+                    W.V[i] = PositiveZero(V[Ix[i]]);  // As the radix sort stores it
+            });
+        }
+    }
+
+    /* Argsorts the non-empty intervals by their starting and closing values. All
+     * scratch space is sized on the calling thread.
+     * S:       An array of interval starting values
+     * E:       An array of interval closing values
+     * N:       The number of elements in S and E
+     * SS:      Output; indices of non-empty intervals ordered by starting value
+     * SE:      Output; indices of non-empty intervals ordered by closing value
+     * P:       Maximum number of threads to use
+     * WS, WE:  Scratch space for sorting SS and SE; WS.V and WE.V receive the values of
+     *          S and E in the order of SS and SE */
+    template <typename T, typename Vec>
+    void ArgSort(const T* S, const T* E, const size_t N, Vec& SS, Vec& SE, size_t P, SortScratch<T>& WS, SortScratch<T>& WE) {
+        SS.clear();
+        SE.clear();
         SS.reserve(N);
         SE.reserve(N);
         for (size_t i = 0; i < N; ++i) {
-            if (S[i] != E[i]) { // [a, a) is an empty interval
+            if (S[i] < E[i]) {  // [a, b) with b <= a is empty
                 PUSHBACK(SS, i);
                 PUSHBACK(SE, i);
             }
         }
-        const size_t NF = SS.size();    // Number of filtered values
-        // Argsort starting and ending intervals
-        std::sort(SS.begin(), SS.end(), [&S](size_t i1, size_t i2) { return S[i1] < S[i2]; });
-        std::sort(SE.begin(), SE.end(), [&E](size_t i1, size_t i2) { return E[i1] < E[i2]; });
-        // Clear and reserve space
-        Clear();
-        Tab.reserve(NF * 2 + 2);     // 1 for each start/end + 2 for -inf and +inf
-        IList.reserve(NF * 2 + 2);   // 1 element for each above
-        constexpr T MINV = std::numeric_limits<T>::has_infinity ? NEG_INFTY : std::numeric_limits<T>::min();
-        constexpr T MAXV = std::numeric_limits<T>::has_infinity ? POS_INFTY : std::numeric_limits<T>::max();
-        // Record number of intervals satisfied at each start and end point
-        size_t i1 = 0, i2 = 0;  // Start point index, end point index
-        std::set<size_t> AS;    // Active set
-        // Starting point interval; catch everything below lowest start point
-        if (0 == NF || S[SS[0]] > MINV) {
-            PUSHBACK(Tab, MINV);
-            PUSHBACK(IList, Empty);
+        // Ties are broken by index so intervals opening or closing together are in index order
+        const bool Split = (P > 1) && (SS.size() >= PAR_MIN);
+        WS.Fit(SS.size(), Split ? P / 2 : P);
+        WE.Fit(SE.size(), Split ? P - P / 2 : P);
+        if (Split) {
+            // Run the two sorts concurrently, splitting the threads between them
+            ParallelFor(2, [&](size_t t) {
+                if (t == 0)
+                    SortIndices(S, SS, P / 2, WS);
+                else
+                    SortIndices(E, SE, P - P / 2, WE);
+            });
+        }
+        else {
+            SortIndices(S, SS, P, WS);
+            SortIndices(E, SE, P, WE);
         }
-        while ((i1 < NF) || (i2 < NF)) {    // Loop over each value start and end point
+    }
+
+    /* Computes the active set following a breakpoint from the one preceding it.
+     * All runs are sorted; O must be disjoint from A and C must be a subset of A and O.
+     * A, AE:   The previous active set
+     * O, OE:   Intervals opening at the breakpoint
+     * C, CE:   Intervals closing at the breakpoint
+     * Out:     Output; receives (A + O) - C, which must not overlap the inputs
+     * Return:  One past the last index written */
+    template <typename IA, typename ID>
+    IA* MergeDelta(const IA* A, const IA* AE, const ID* O, const ID* OE, const ID* C, const ID* CE, IA* Out) {
+        while ((A != AE) || (O != OE)) {
+            const size_t i = ((O == OE) || ((A != AE) && (*A < *O))) ? *A++ : *O++;
+            if ((C != CE) && (*C == i))
+                ++C;        // Closing; drop it
+            else
+                *Out++ = IA(i);
+        }
+        assert(C == CE);
+        return Out;
+    }
+
+    // Value below every breakpoint; -inf if T has it
+    template <typename T>
+    constexpr T MinValue() {
+        return std::numeric_limits<T>::has_infinity ? NEG_INFTY : std::numeric_limits<T>::min();
+    }
+
+    // Value above every breakpoint; +inf if T has it
+    template <typename T>
+    constexpr T MaxValue() {
+        return std::numeric_limits<T>::has_infinity ? POS_INFTY : std::numeric_limits<T>::max();
+    }
+
+    /* Walks the breakpoints made by a range of argsorted opens and closes in increasing order.
+     * Every open or close with the value of a breakpoint in the range must be in the range.
+     * SV, EV:  Interval starting and closing values in the order given by ArgSort
+     * o, oe:   The range of SV
+     * c, ce:   The range of EV
+     * F:       Called as F(v, o1, o2, c1, c2) for each breakpoint v; intervals SS[o1, o2)
+     *          open at v and intervals SE[c1, c2) close at v */
+    template <typename T, typename Fn>
+    void SweepRange(const T* SV, const T* EV, size_t o, const size_t oe, size_t c, const size_t ce, Fn F) {
+        while ((o < oe) || (c < ce)) {    // Loop over each value start and end point
             // The next value to merge into the table
-            const T& v = ((i1 >= NF) || ((i2 < NF) && (S[SS[i1]] >= E[SE[i2]]))) ? E[SE[i2]] : S[SS[i1]];
-            // Update the active set with intervals opening and closing at this point
-            while ((i1 < NF) && (S[SS[i1]] == v))
-                AS.insert(SS[i1++]);    // These intervals are opening
-            while ((i2 < NF) && (E[SE[i2]] == v))
-                AS.erase(SE[i2++]);     // These intervals are closing
-            // Active set guaranteed to have changed; record new interval ending here
-            PUSHBACK(Tab, v);
-            PUSHBACK(IList, std::vector<size_t>(AS.begin(), AS.end()));
-            assert(Tab.size() < 2 || Tab[Tab.size() - 1] != Tab[Tab.size() - 2]);
-            assert(IList.size() < 2 || IList[IList.size() - 1] != IList[IList.size() - 2]);
+            const T v = ((o >= oe) || ((c < ce) && (SV[o] >= EV[c]))) ? EV[c] : SV[o];
+            const size_t o1 = o, c1 = c;
+            while ((o < oe) && (SV[o] == v))
+                ++o;    // These intervals are opening
+            while ((c < ce) && (EV[c] == v))
+                ++c;    // These intervals are closing
+            F(v, o1, o, c1, c);
         }
+    }
+
+    /* Walks the breakpoints of a set of argsorted intervals in increasing order,
+     * including the -inf and +inf sentinels when they are not already present.
+     * SV, EV:  Interval starting and closing values in the order given by ArgSort
+     * NF:      Number of elements in SV and EV
+     * F:       Called as F(v, o1, o2, c1, c2) for each breakpoint v; intervals SS[o1, o2)
+     *          open at v and intervals SE[c1, c2) close at v */
+    template <typename T, typename Fn>
+    void Sweep(const T* SV, const T* EV, const size_t NF, Fn F) {
+        // Starting point interval; catch everything below lowest start point
+        if (0 == NF || SV[0] > MinValue<T>())
+            F(MinValue<T>(), 0, 0, 0, 0);
+        SweepRange(SV, EV, 0, NF, 0, NF, F);
         // Endpoint interval; catch everything above largest end point
-        if (0 == NF || E[SE[NF - 1]] < MAXV) {
-            PUSHBACK(Tab, MAXV);
-            PUSHBACK(IList, Empty);
+        if (0 == NF || EV[NF - 1] < MaxValue<T>())
+            F(MaxValue<T>(), NF, NF, NF, NF);
+    }
+
+    // Number of consecutive set bits starting from the least significant bit
+    inline unsigned TrailingOnes(size_t k) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (~k == 0) ? std::numeric_limits<size_t>::digits : __builtin_ctzll(~k);
+#else
+        unsigned n = 0;
+        for (; k & 1; k >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    // Number of keys per S-tree node
+    constexpr size_t STREE_B = 16;
+
+    /* Index of the first key of an S-tree node greater than a query point, given
+     * the mask of keys greater than it. The keys are sorted, so the mask is a run
+     * of high bits and the index is its number of trailing zeros, which is a single
+     * instruction on any x86-64 (popcount is a library call without -mpopcnt).
+     * m:       Bit i is set if key i is greater than the query point
+     * Return:  The index of the first key greater than the point, or STREE_B if none */
+    inline unsigned FirstGreater(unsigned m) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctz(m | (1u << STREE_B));
+#else
+        unsigned n = 0;
+        for (m |= 1u << STREE_B; !(m & 1); m >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    /* Counts the keys of an S-tree node that are not greater than a query point.
+     * Specialized with SIMD for int, unsigned int, float and double when available.
+     * K:       The STREE_B sorted keys of the node
+     * p:       The query point
+     * Return:  The index of the first key greater than p, or STREE_B if none */
+    template <typename T>
+    inline unsigned CountNotGreater(const T* K, const T& p) {
+        unsigned n = 0;
+        for (size_t i = 0; i < STREE_B; ++i)
+            n += !(p < K[i]);
+        return n;
+    }
+
+#if defined(__AVX2__)
+    inline unsigned CountNotGreater(const int* K, const int& p) {
+        const __m256i P = _mm256_set1_epi32(p);
+        const __m256i G0 = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)K), P);
+        const __m256i G1 = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(K + 8)), P);
+        const unsigned M = _mm256_movemask_ps(_mm256_castsi256_ps(G0)) | (_mm256_movemask_ps(_mm256_castsi256_ps(G1)) << 8);
+        return FirstGreater(M);
+    }
+
+    inline unsigned CountNotGreater(const unsigned int* K, const unsigned int& p) {
+        // Flip the sign bit so the signed comparison orders unsigned values
+        const __m256i F = _mm256_set1_epi32(std::numeric_limits<int>::min());
+        const __m256i P = _mm256_xor_si256(_mm256_set1_epi32(p), F);
+        const __m256i G0 = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)K), F), P);
+        const __m256i G1 = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(K + 8)), F), P);
+        const unsigned M = _mm256_movemask_ps(_mm256_castsi256_ps(G0)) | (_mm256_movemask_ps(_mm256_castsi256_ps(G1)) << 8);
+        return FirstGreater(M);
+    }
+
+    inline unsigned CountNotGreater(const float* K, const float& p) {
+        const __m256 P = _mm256_set1_ps(p);
+        const unsigned M = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(K), P, _CMP_GT_OQ)) |
+                           (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(K + 8), P, _CMP_GT_OQ)) << 8);
+        return FirstGreater(M);
+    }
+
+    inline unsigned CountNotGreater(const double* K, const double& p) {
+        const __m256d P = _mm256_set1_pd(p);
+        unsigned M = 0;
+        for (unsigned i = 0; i < 4; ++i)
+            M |= _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(K + 4 * i), P, _CMP_GT_OQ)) << (4 * i);
+        return FirstGreater(M);
+    }
+#elif defined(__SSE2__)
+    inline unsigned CountNotGreater(const int* K, const int& p) {
+        const __m128i P = _mm_set1_epi32(p);
+        unsigned M = 0;
+        for (unsigned i = 0; i < 4; ++i) {
+            const __m128i G = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(K + 4 * i)), P);
+            M |= _mm_movemask_ps(_mm_castsi128_ps(G)) << (4 * i);
+        }
+        return FirstGreater(M);
+    }
+
+    inline unsigned CountNotGreater(const unsigned int* K, const unsigned int& p) {
+        // Flip the sign bit so the signed comparison orders unsigned values
+        const __m128i F = _mm_set1_epi32(std::numeric_limits<int>::min());
+        const __m128i P = _mm_xor_si128(_mm_set1_epi32(p), F);
+        unsigned M = 0;
+        for (unsigned i = 0; i < 4; ++i) {
+            const __m128i G = _mm_cmpgt_epi32(_mm_xor_si128(_mm_loadu_si128((const __m128i*)(K + 4 * i)), F), P);
+            M |= _mm_movemask_ps(_mm_castsi128_ps(G)) << (4 * i);
+        }
+        return FirstGreater(M);
+    }
+
+    inline unsigned CountNotGreater(const float* K, const float& p) {
+        const __m128 P = _mm_set1_ps(p);
+        unsigned M = 0;
+        for (unsigned i = 0; i < 4; ++i)
+            M |= _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(K + 4 * i), P)) << (4 * i);
+        return FirstGreater(M);
+    }
+
+    inline unsigned CountNotGreater(const double* K, const double& p) {
+        const __m128d P = _mm_set1_pd(p);
+        unsigned M = 0;
+        for (unsigned i = 0; i < 8; ++i)
+            M |= _mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(K + 2 * i), P)) << (2 * i);
+        return FirstGreater(M);
+    }
+#endif
+
+    /* Finds the slot containing the result for a query point in a sorted breakpoint table.
+     * For arithmetic types this is a branch-free binary search: each step halves the
+     * range with a conditional move instead of a branch the query stream would make
+     * unpredictable, and prefetches both candidates for the next midpoint so the
+     * next cache miss starts before the comparison resolves.
+     * t:       The breakpoint table
+     * n:       Number of breakpoints
+     * p:       The query point
+     * Return:  The largest x such that t[x] <= p, or the largest size_t if there is none */
+    template <typename T>
+    size_t FindSlot(const T* t, size_t n, const T& p) {
+        if constexpr (std::is_arithmetic<T>::value) {
+            if (n == 0)
+                return std::numeric_limits<size_t>::max();
+            const T* b = t;     // t[0, b - t) <= p, or b == t
+            while (n > 1) {
+                const size_t h = n / 2;
+                const size_t hn = (n - h) / 2;
+                RM_PREFETCH(b + hn);
+                RM_PREFETCH(b + h + hn);
+                b = (p < b[h]) ? b : (b + h);
+                n -= h;
+            }
+            // Only b == t can be greater than p; wraps to the largest size_t then
+            return size_t(b - t) - size_t(p < *b);
+        }
+        else
+            return (std::upper_bound(t, t + n, p) - t) - 1;
+    }
+
+    // Number of halvings taken by a binary search over n elements
+    inline unsigned SearchSteps(size_t n) {
+        unsigned s = 0;
+        for (; n > 1; ++s)
+            n -= n / 2;
+        return s;
+    }
+}
+
+/* Read-only view over a contiguous run of interval indices of type I. Returned
+ * by RangeMap::Query; valid until the owning map is rebuilt or cleared. */
+template <typename I>
+class BasicIndexView {
+    const I* B = nullptr;   // First index in the run
+    const I* E = nullptr;   // One past the last index in the run
+
+public:
+    BasicIndexView() = default;
+    BasicIndexView(const I* b, const I* e) : B(b), E(e) { }
+
+    const I* begin() const { return B; }
+    const I* end() const { return E; }
+    const I* data() const { return B; }
+    size_t size() const { return E - B; }
+    bool empty() const { return B == E; }
+    const I& operator[](size_t i) const { return B[i]; }
+};
+
+typedef BasicIndexView<size_t> IndexView;
+
+template <typename T, typename I = size_t>
+class MappedRangeMap;
+
+/* Class for solving the following problem:
+ * Given a list L of intervals of the form [a, b) and a point p,
+ * determine the set of all intervals in L that contain p.
+ * Results are stored in compressed (CSR) form: the intervals active
+ * after breakpoint Tab[x] are Idx[Off[x]] ... Idx[Off[x + 1] - 1].
+ *
+ * I is the type used to store interval indices and must be able to hold N - 1
+ * for N intervals, or Build refuses the input; uint32_t or uint16_t halve or
+ * quarter the size of the index lists, which dominate the memory of the map.
+ *
+ * Probe is the instrumentation policy called from Query, Count and Build; the
+ * default NoProbe records nothing and costs nothing. */
+template <typename T, typename I = size_t, typename Probe = NoProbe>
+class RangeMap {
+    static_assert(std::is_integral<I>::value && std::is_unsigned<I>::value, "Interval index type must be an unsigned integer");
+
+    std::pmr::vector<T> Tab;        // Internal table for searching intervals
+    std::pmr::vector<size_t> Off;   // Offsets into Idx; one per breakpoint plus a terminator
+    std::pmr::vector<I> Idx;        // Concatenated interval indices for all breakpoints
+    std::pmr::vector<I> Opens;      // Interval indices ordered by starting value; only kept for QueryRange
+    std::pmr::vector<size_t> OPos;  // Opens[OPos[x], OPos[x + 1]) open at breakpoint x; only kept for QueryRange
+    typedef std::pair<size_t, size_t> Span;    // A range of Idx
+
+    std::pmr::vector<T> Eyt;        // Tab in Eytzinger order (1-based) when using that layout
+    std::pmr::vector<Span> ESpan;   // Result for the slot preceding each element of Eyt
+    std::pmr::vector<T> SKey;       // S-tree nodes of STREE_B keys each when using that layout
+    std::pmr::vector<Span> SSpan;   // Result for the slot preceding each element of SKey
+    Span STail;                     // Result when no element of SKey is greater than the query point
+    SearchLayout Layout = SearchLayout::Sorted;
+    bool CountOnly = false;         // Only Off is built; Idx is left empty
+    bool Windows = false;           // Opens and OPos are kept so QueryRange can be used
+    size_t BuildAllocs = 0;         // Buffers the last Build allocated or grew, including temporary ones
+    size_t Threads = 1;             // Maximum number of threads used by Build
+
+    static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+    static constexpr size_t BATCH = 16;     // Number of searches interleaved by QueryBatch
+    static constexpr size_t GALLOP = 1024;  // Largest step taken when galloping from a nearby slot
+
+    friend class MappedRangeMap<T, I>;  // Saves the map to disk
+
+    // Result for the slot preceding Tab[i]
+    Span Preceding(size_t i) const {
+        return i ? Span(Off[i - 1], Off[i]) : Span(0, 0);
+    }
+
+    // Fills Eyt and ESpan from the sorted elements of Tab starting at index i
+    size_t FillEytzinger(size_t k, size_t i) {
+        if (k < Eyt.size()) {
+            i = FillEytzinger(2 * k, i);
+            Eyt[k] = Tab[i];
+            ESpan[k] = Preceding(i);
+            i = FillEytzinger(2 * k + 1, i + 1);
+        }
+        return i;
+    }
+
+    // Fills S-tree node k and its descendants from the sorted elements of Tab starting at index i
+    size_t FillSTree(size_t k, size_t i) {
+        constexpr size_t B = RMImpl::STREE_B;
+        if (k * B < SKey.size()) {
+            for (size_t j = 0; j < B; ++j) {
+                i = FillSTree(k * (B + 1) + j + 1, i);
+                // Pad the last node with the largest key; these act like +inf
+                SKey[k * B + j] = (i < Tab.size()) ? Tab[i] : Tab.back();
+                SSpan[k * B + j] = (i < Tab.size()) ? Preceding(i) : STail;
+                ++i;
+            }
+            i = FillSTree(k * (B + 1) + B + 1, i);
+        }
+        return i;
+    }
+
+    // Builds the auxiliary search structure for the current layout
+    void BuildLayout() {
+        Eyt.clear();
+        ESpan.clear();
+        SKey.clear();
+        SSpan.clear();
+        if (Tab.empty())
+            return;
+        STail = Span(Off[Tab.size() - 1], Off[Tab.size()]);
+        if (Layout == SearchLayout::Eytzinger) {
+            Eyt.resize(Tab.size() + 1);
+            ESpan.resize(Tab.size() + 1);
+            FillEytzinger(1, 0);
+            // Slot 0 is unused by the tree; it holds the result when p >= Tab[n - 1]
+            ESpan[0] = STail;
+        }
+        else if (Layout == SearchLayout::STree) {
+            const size_t NB = (Tab.size() + RMImpl::STREE_B - 1) / RMImpl::STREE_B;
+            SKey.resize(NB * RMImpl::STREE_B);
+            SSpan.resize(NB * RMImpl::STREE_B);
+            FillSTree(0, 0);
+        }
+    }
+
+    /* Searches the Eytzinger layout for a query point
+     * p:       The query point
+     * Steps:   Output; incremented for each level visited; null if the probe is disabled
+     * Return:  The range of Idx holding the result */
+    const Span& EytzingerSpan(const T& p, unsigned* Steps) const {
+        // Descend to the first element greater than p, prefetching 4 levels ahead
+        constexpr size_t PF = (sizeof(T) < 64) ? (64 / sizeof(T)) : 1;
+        const size_t n = Eyt.size() - 1;
+        size_t k = 1;
+        while (k <= n) {
+            RM_PREFETCH(Eyt.data() + std::min(k * PF, n));
+            k = 2 * k + !(p < Eyt[k]);
+            if constexpr (Probe::Enabled)
+                ++*Steps;
+        }
+        // Undo the right turns taken after the last left turn; k = 0 if p >= Tab[n - 1]
+        k >>= RMImpl::TrailingOnes(k) + 1;
+        return ESpan[k];
+    }
+
+    /* Searches the S-tree layout for a query point
+     * p:       The query point
+     * Steps:   Output; incremented for each node visited; null if the probe is disabled
+     * Return:  The range of Idx holding the result */
+    const Span& STreeSpan(const T& p, unsigned* Steps) const {
+        constexpr size_t B = RMImpl::STREE_B;
+        const size_t NB = SKey.size() / B;
+        const Span* R = &STail;
+        // Each node narrows the search to the child between the keys bracketing p
+        for (size_t k = 0; k < NB; ) {
+            const size_t j = RMImpl::CountNotGreater(SKey.data() + k * B, p);
+            if (j < B)
+                R = &SSpan[k * B + j];
+            k = k * (B + 1) + j + 1;
+            if constexpr (Probe::Enabled)
+                ++*Steps;
+        }
+        return *R;
+    }
+
+    /* Searches the current layout for a query point and reports the search to the probe
+     * p:       The query point
+     * Return:  The range of Idx holding the result */
+    Span Find(const T& p) const {
+        // Search steps; only passed to the search if the probe is enabled, so a disabled
+        // probe leaves the search exactly as if it had no hooks (see RMCodegen.sh)
+        unsigned Steps = 0;
+        Span R;
+        if (!Eyt.empty())
+            R = EytzingerSpan(p, Probe::Enabled ? &Steps : nullptr);
+        else if (!SKey.empty())
+            R = STreeSpan(p, Probe::Enabled ? &Steps : nullptr);
+        else {
+            const size_t x = Slot(p);
+            R = (x == NONE) ? Span(0, 0) : Span(Off[x], Off[x + 1]);
+            if constexpr (Probe::Enabled)
+                Steps = RMImpl::SearchSteps(Tab.size());
+        }
+        if constexpr (Probe::Enabled)
+            Probe::Query(Steps, R.second - R.first);
+        return R;
+    }
+
+    /* Finds the slot containing the result for a query point in Tab
+     * p:       The query point
+     * Return:  The largest x such that Tab[x] <= p or NONE */
+    size_t Slot(const T& p) const {
+        return RMImpl::FindSlot(Tab.data(), Tab.size(), p);
+    }
+
+    /* Finds the slots for a group of query points with interleaved branch-free
+     * binary searches over Tab, prefetching both candidate midpoints of each
+     * search one step ahead so the cache misses of the group overlap.
+     * P:   Array of query points
+     * G:   Number of query points; at most BATCH
+     * X:   Output; the largest x such that Tab[x] <= P[j] or NONE for each point */
+    void SlotBatch(const T* P, const size_t G, size_t* X) const {
+        const T* t = Tab.data();
+        size_t B[BATCH];
+        for (size_t j = 0; j < G; ++j)
+            B[j] = 0;
+        for (size_t n = Tab.size(); n > 1; ) {
+            const size_t h = n / 2;     // All searches share the same sequence of lengths
+            const size_t hn = (n - h) / 2;
+            for (size_t j = 0; j < G; ++j) {
+                RM_PREFETCH(t + B[j] + hn);
+                RM_PREFETCH(t + B[j] + h + hn);
+                B[j] = (P[j] < t[B[j] + h]) ? B[j] : (B[j] + h);
+            }
+            n -= h;
+        }
+        for (size_t j = 0; j < G; ++j)
+            X[j] = (Tab.empty() || (P[j] < t[B[j]])) ? NONE : B[j];
+    }
+
+    /* Finds the slot for a query point by galloping outward from a nearby slot,
+     * which costs O(log d) for a slot d positions away. Gives up galloping after
+     * Limit positions and searches the remaining table instead, which caps the
+     * cost of a far jump at about one binary search over the table.
+     * p:       The query point
+     * x:       Slot to start from; NONE is treated as 0
+     * Limit:   Largest step taken; the largest size_t gallops all the way
+     * Return:  The largest x such that Tab[x] <= p or NONE */
+    size_t SlotNear(const T& p, size_t x, const size_t Limit) const {
+        const size_t n = Tab.size();
+        if ((n == 0) || (p < Tab[0]))
+            return NONE;
+        x = (x == NONE) ? 0 : x;
+        size_t Lo, Hi;  // Tab[Lo] <= p < Tab[Hi], where Tab[n] is taken as +inf
+        size_t Step = 1;
+        if (!(p < Tab[x])) {    // Gallop forward
+            for (Lo = x; (Step <= Limit) && (Lo + Step < n) && !(p < Tab[Lo + Step]); Step *= 2)
+                Lo += Step;
+            Hi = (Step > Limit) ? n : std::min(Lo + Step, n);
         }
+        else {                  // Gallop backward; Tab[0] <= p so this stops at 0
+            for (Hi = x; (Step <= Limit) && (Hi >= Step) && (p < Tab[Hi - Step]); Step *= 2)
+                Hi -= Step;
+            Lo = ((Step > Limit) || (Hi < Step)) ? 0 : (Hi - Step);
+        }
+        return (std::upper_bound(Tab.begin() + Lo + 1, Tab.begin() + Hi, p) - Tab.begin()) - 1;
+    }
+
+    // The result for slot x
+    BasicIndexView<I> View(const size_t x) const {
+        if ((x == NONE) || CountOnly)
+            return BasicIndexView<I>();
+        return BasicIndexView<I>(Idx.data() + Off[x], Idx.data() + Off[x + 1]);
+    }
+
+    // Appends the result for slot x to RIdx if it fits in Cap and returns the new total size
+    size_t Append(const size_t x, const size_t Tot, I* RIdx, const size_t Cap) const {
+        if ((x == NONE) || CountOnly)
+            return Tot;
+        const I* B = Idx.data() + Off[x];
+        const I* E = Idx.data() + Off[x + 1];
+        if (Tot + (E - B) <= Cap)
+            std::copy(B, E, RIdx + Tot);
+        return Tot + (E - B);
+    }
+
+    /* Records the breakpoints and the offsets of their active sets using P threads.
+     * The breakpoints are split by value into P segments with about the same number
+     * of opens. Each segment is walked once to count its breakpoints and indices,
+     * the counts are prefix-summed, and each is walked again to write its part of
+     * Tab, Off and OPos, so the result is the same as a serial sweep.
+     * SV, EV:      Interval starting and closing values in the order given by ArgSort; not empty
+     * NF:          Number of elements in SV and EV
+     * P:           Number of segments
+     * KeepWindows: True to fill OPos
+     * R:           Memory resource for temporary buffers */
+    void SweepSegments(const T* SV, const T* EV, const size_t NF, const size_t P, const bool KeepWindows, std::pmr::memory_resource* R) {
+        // Segment t holds the opens SV[O[t], O[t + 1]) and the closes EV[C[t], C[t + 1])
+        std::pmr::vector<size_t> O(P + 1, R), C(P + 1, R);
+        // Breakpoints and indices of segment t, then of all segments before it
+        std::pmr::vector<size_t> Cnt(P + 1, R), Sum(P + 1, R);
+        O[P] = C[P] = NF;
+        for (size_t t = 1; t < P; ++t) {
+            const T& v = SV[NF * t / P];
+            O[t] = std::lower_bound(SV, SV + NF, v) - SV;
+            C[t] = std::lower_bound(EV, EV + NF, v) - EV;
+        }
+        RMImpl::ParallelFor(P, [&](size_t t) {
+            size_t NA = O[t] - C[t];    // Intervals opened before the segment and still open
+            RMImpl::SweepRange(SV, EV, O[t], O[t + 1], C[t], C[t + 1], [&](const T&, size_t o1, size_t o2, size_t c1, size_t c2) {
+                NA = NA + (o2 - o1) - (c2 - c1);
+                ++Cnt[t + 1];
+                Sum[t + 1] += NA;
+            });
+        });
+        // The -inf sentinel comes before every segment and the +inf sentinel after
+        const bool Lead = SV[0] > RMImpl::MinValue<T>();
+        const bool Tail = EV[NF - 1] < RMImpl::MaxValue<T>();
+        Cnt[0] = Lead;
+        std::partial_sum(Cnt.begin(), Cnt.end(), Cnt.begin());
+        std::partial_sum(Sum.begin(), Sum.end(), Sum.begin());
+        const size_t n = Cnt[P] + Tail;
+        Tab.resize(n);
+        Off.resize(n + 1);
+        if (KeepWindows)
+            OPos.resize(n + 1);
+        if (Lead) {
+            Tab[0] = RMImpl::MinValue<T>();
+            Off[1] = 0;
+            if (KeepWindows)
+                OPos[1] = 0;
+        }
+        RMImpl::ParallelFor(P, [&](size_t t) {
+            size_t NA = O[t] - C[t];
+            size_t Tot = Sum[t];
+            size_t x = Cnt[t];
+            RMImpl::SweepRange(SV, EV, O[t], O[t + 1], C[t], C[t + 1], [&](const T& v, size_t o1, size_t o2, size_t c1, size_t c2) {
+                NA = NA + (o2 - o1) - (c2 - c1);
+                Tot += NA;
+                Tab[x] = v;
+                Off[x + 1] = Tot;
+                if (KeepWindows)
+                    OPos[x + 1] = o2;
+                ++x;
+            });
+            assert(x == Cnt[t + 1]);
+        });
+        if (Tail) {
+            Tab[n - 1] = RMImpl::MaxValue<T>();
+            Off[n] = Off[n - 1];
+            if (KeepWindows)
+                OPos[n] = NF;
+        }
+    }
+
+    /* Writes the first active set of each fill segment not starting at the first
+     * breakpoint in one pass over the intervals, split into P chunks: each chunk
+     * counts the intervals it adds to each set, the counts are prefix-summed over
+     * the chunks, and each chunk then writes its intervals in index order.
+     * S, E:    Interval starting and closing values
+     * N:       Number of elements in S and E
+     * Bx:      The breakpoints to seed in increasing order; none is 0
+     * K:       Number of elements in Bx
+     * P:       Number of chunks
+     * R:       Memory resource for temporary buffers */
+    void SeedSegments(const T* S, const T* E, const size_t N, const size_t* Bx, const size_t K, const size_t P,
+                      std::pmr::memory_resource* R) {
+        std::pmr::vector<T> V(R);
+        V.reserve(K);
+        for (size_t k = 0; k < K; ++k)
+            V.push_back(Tab[Bx[k]]);
+        // Intervals of chunk q active at V[k], then where chunk q writes them; at W[q * K + k]
+        std::pmr::vector<size_t> W(P * K, R);
+        auto Chunk = [N, P](size_t q) { return N * q / P; };
+        // Calls F(k) for each k with S[i] <= V[k] < E[i]; most intervals contain none
+        auto Seeds = [&](size_t i, auto F) {
+            // The first k with S[i] <= V[k]; x is NONE (so k is 0) if every V[k] is greater
+            const size_t x = RMImpl::FindSlot(V.data(), K, S[i]);
+            for (size_t k = x + ((x == NONE) || (V[x] < S[i])); (k < K) && (V[k] < E[i]); ++k)
+                F(k);
+        };
+        RMImpl::ParallelFor(P, [&](size_t q) {
+            for (size_t i = Chunk(q); i < Chunk(q + 1); ++i)
+                Seeds(i, [&](size_t k) { ++W[q * K + k]; });
+        });
+        for (size_t k = 0; k < K; ++k) {
+            size_t Pos = Off[Bx[k]];
+            for (size_t q = 0; q < P; ++q) {
+                const size_t c = W[q * K + k];
+                W[q * K + k] = Pos;
+                Pos += c;
+            }
+            assert(Pos == Off[Bx[k] + 1]);
+        }
+        RMImpl::ParallelFor(P, [&](size_t q) {
+            for (size_t i = Chunk(q); i < Chunk(q + 1); ++i)
+                Seeds(i, [&](size_t k) { Idx[W[q * K + k]++] = I(i); });
+        });
+    }
+
+    /* Fills the index lists for breakpoints [b, e). Each active set is the previous
+     * one with the deltas at its breakpoint applied; a segment not starting at the
+     * first breakpoint starts from the set written by SeedSegments, so segments can
+     * be filled independently.
+     * SS, SE:  Output of ArgSort
+     * SV, EV:  Interval starting and closing values in the order of SS and SE
+     * b, e:    The range of breakpoints to fill */
+    void FillSegment(const std::pmr::vector<size_t>& SS, const std::pmr::vector<size_t>& SE, const T* SV, const T* EV,
+                     const size_t b, const size_t e) {
+        const size_t NF = SS.size();
+        size_t o = 0, c = 0;    // Positions in SS and SE of the next intervals to open and close
+        size_t x = b;           // Current breakpoint
+        if ((b > 0) && (b < e)) {
+            o = std::upper_bound(SV, SV + NF, Tab[b]) - SV;
+            c = std::upper_bound(EV, EV + NF, Tab[b]) - EV;
+            ++x;
+        }
+        for (; x < e; ++x) {
+            const T& v = Tab[x];
+            const size_t o1 = o, c1 = c;
+            while ((o < NF) && (SV[o] == v))
+                ++o;    // These intervals are opening
+            while ((c < NF) && (EV[c] == v))
+                ++c;    // These intervals are closing
+            const I* A = Idx.data() + Off[x - (x > 0)];
+            const I* W = RMImpl::MergeDelta(A, Idx.data() + Off[x], SS.data() + o1, SS.data() + o,
+                                                 SE.data() + c1, SE.data() + c, Idx.data() + Off[x]);
+            assert(W == Idx.data() + Off[x + 1]);
+            (void)W;
+        }
+    }
+
+public:
+    /* R:   Memory resource for the map's storage and the scratch space used by
+     *      Build, which is only allocated from the calling thread. A monotonic
+     *      arena lets many short-lived maps be built and freed at once. */
+    explicit RangeMap(std::pmr::memory_resource* R = std::pmr::get_default_resource()) :
+        Tab(R), Off(R), Idx(R), Opens(R), OPos(R), Eyt(R), ESpan(R), SKey(R), SSpan(R) { }
+
+    /* Scratch space used by Build. Passing the same context to repeated builds
+     * keeps its buffers, and the map keeps the capacity of its own storage, so
+     * once both have grown to fit the input a single-threaded rebuild makes no
+     * heap allocations. A context may be shared by maps of the same key type but
+     * not by concurrent builds. */
+    class BuildContext {
+        friend class RangeMap;
+        std::pmr::vector<size_t> SS, SE;    // Interval indices ordered by starting and closing value
+        RMImpl::SortScratch<T> WS, WE;      // Scratch for sorting by starting and closing value
+
+    public:
+        explicit BuildContext(std::pmr::memory_resource* R = std::pmr::get_default_resource()) : SS(R), SE(R), WS(R), WE(R) { }
+    };
+
+    /* Builds the RangeMap from a list of intervals like [a, b)
+     * S:       An array of interval starting values
+     * E:       An array of interval closing values
+     * N:       The number of elements in S and E
+     * Return:  False if I cannot hold N - 1; the map is then left unchanged */
+    bool Build(const T* S, const T* E, const size_t N) {
+        BuildContext C(Tab.get_allocator().resource());
+        return Build(S, E, N, C);
+    }
+
+    /* Builds the RangeMap from a list of intervals like [a, b), reusing scratch space
+     * S:       An array of interval starting values
+     * E:       An array of interval closing values
+     * N:       The number of elements in S and E
+     * C:       Scratch space kept between builds
+     * Return:  False if I cannot hold N - 1; the map is then left unchanged */
+    bool Build(const T* S, const T* E, const size_t N, BuildContext& C) {
+        if (nullptr == S || nullptr == E || N == 0)
+            return true;
+        if (N - 1 > std::numeric_limits<I>::max())
+            return false;   // Indices would wrap
+        // Every buffer kept after Build; a change in capacity is an allocation
+        auto Capacities = [&]() {
+            return std::array<size_t, 21>{Tab.capacity(), Off.capacity(), Idx.capacity(), Opens.capacity(), OPos.capacity(),
+                                          Eyt.capacity(), ESpan.capacity(), SKey.capacity(), SSpan.capacity(),
+                                          C.SS.capacity(), C.SE.capacity(),
+                                          C.WS.A.capacity(), C.WS.B.capacity(), C.WS.H.capacity(), C.WS.Tmp.capacity(), C.WS.V.capacity(),
+                                          C.WE.A.capacity(), C.WE.B.capacity(), C.WE.H.capacity(), C.WE.Tmp.capacity(), C.WE.V.capacity()};
+        };
+        const auto Before = Capacities();
+        // Temporary buffers are allocated through this so they are counted too
+        RMImpl::CountingResource Temp(Tab.get_allocator().resource());
+        uint64_t Tick = Probe::Clock();
+        Clear();
+        // Argsort starting and ending intervals filtering any empty intervals
+        std::pmr::vector<size_t>& SS = C.SS;
+        std::pmr::vector<size_t>& SE = C.SE;
+        RMImpl::ArgSort(S, E, N, SS, SE, Threads, C.WS, C.WE);
+        Tick = Probe::Phase(BuildPhase::ArgSort, Tick);
+        const size_t NF = SS.size();    // Number of filtered values
+        const T* SV = C.WS.V.data();    // Starting and closing values in the order of SS and SE
+        const T* EV = C.WE.V.data();
+        const bool KeepWindows = Windows && !CountOnly;
+        Tab.reserve(NF * 2 + 2);     // 1 for each start/end + 2 for -inf and +inf
+        Off.reserve(NF * 2 + 3);     // 1 for each above + 1 terminator
+        PUSHBACK(Off, 0);
+        if (KeepWindows) {
+            Opens.assign(SS.begin(), SS.end());
+            OPos.reserve(NF * 2 + 3);
+            PUSHBACK(OPos, 0);
+        }
+        // First pass: record breakpoints and the size of the active set at each
+        const size_t PS = std::max<size_t>(1, std::min(Threads, NF / RMImpl::PAR_MIN));
+        if (PS > 1)
+            SweepSegments(SV, EV, NF, PS, KeepWindows, &Temp);
+        else {
+            size_t NA = 0;          // Size of active set
+            RMImpl::Sweep(SV, EV, NF, [&](const T& v, size_t o1, size_t o2, size_t c1, size_t c2) {
+                NA += (o2 - o1);
+                NA -= (c2 - c1);
+                // Active set guaranteed to have changed; record new interval ending here
+                PUSHBACK(Tab, v);
+                PUSHBACK(Off, Off.back() + NA);
+                if (KeepWindows) {
+                    PUSHBACK(OPos, o2);
+                }
+                assert(Tab.size() < 2 || Tab[Tab.size() - 1] != Tab[Tab.size() - 2]);
+            });
+        }
+        Tick = Probe::Phase(BuildPhase::Sweep, Tick);
+        // Second pass: each active set is the previous one with this breakpoint's deltas applied
+        if (!CountOnly) {
+            Idx.resize(Off.back());
+            // Split the breakpoints into segments with about the same number of indices each
+            const size_t n = Tab.size();
+            const size_t P = std::max<size_t>(1, std::min(Threads, Idx.size() / RMImpl::PAR_MIN));
+            auto Bound = [&](size_t t) {
+                return (t == P) ? n : (std::lower_bound(Off.begin(), Off.begin() + n, Idx.size() * t / P) - Off.begin());
+            };
+            if (P == 1)
+                FillSegment(SS, SE, SV, EV, 0, n);
+            else {
+                std::pmr::vector<size_t> B(&Temp);     // Start of each segment
+                std::pmr::vector<size_t> Bx(&Temp);    // Starts needing a seed
+                B.reserve(P + 1);
+                Bx.reserve(P);
+                for (size_t t = 0; t <= P; ++t) {
+                    PUSHBACK(B, Bound(t));
+                }
+                for (size_t t = 1; t < P; ++t) {
+                    if ((B[t] > 0) && (B[t] < B[t + 1])) {
+                        PUSHBACK(Bx, B[t]);
+                    }
+                }
+                SeedSegments(S, E, N, Bx.data(), Bx.size(), P, &Temp);
+                RMImpl::ParallelFor(P, [&](size_t t) { FillSegment(SS, SE, SV, EV, B[t], B[t + 1]); });
+            }
+        }
+        BuildLayout();
+        Probe::Phase(BuildPhase::Materialize, Tick);
+        const auto After = Capacities();
+        BuildAllocs = Temp.Allocs;
+        for (size_t i = 0; i < Before.size(); ++i)
+            BuildAllocs += (Before[i] != After[i]);
+        return true;
     }
 
     // Clears all elements from the range map
     void Clear() {
         Tab.clear();
-        IList.clear();
+        Off.clear();
+        Idx.clear();
+        Opens.clear();
+        OPos.clear();
+        Eyt.clear();
+        ESpan.clear();
+        SKey.clear();
+        SSpan.clear();
+    }
+
+    /* Selects the layout used to search breakpoints; kept across calls to Build
+     * L:   The search layout */
+    void SetLayout(SearchLayout L) {
+        Layout = L;
+        BuildLayout();
+    }
+
+    /* Sets the maximum number of threads used by Build. The result does not depend
+     * on the number of threads. Kept across calls to Build.
+     * P:   Maximum number of threads */
+    void SetThreads(size_t P) {
+        Threads = std::max<size_t>(1, P);
+    }
+
+    /* Sets whether Build stores only the number of intervals containing each
+     * breakpoint. This makes the map O(N) in memory for any input but only Count
+     * may be used to query it; Query, Cursor::Query, QueryBatch, QuerySorted and
+     * QueryRange return empty results. Kept across calls to Build.
+     * C:   True to skip storing the index lists */
+    void SetCountOnly(bool C) {
+        CountOnly = C;
+    }
+
+    /* Sets whether Build keeps the intervals ordered by starting value, which
+     * QueryRange needs. This costs one I per interval plus one size_t per
+     * breakpoint and is ignored for count-only maps. Kept across calls to Build.
+     * W:   True to allow QueryRange */
+    void SetWindowQueries(bool W) {
+        Windows = W;
+    }
+
+    /* Reports the size and memory use of the map. Building with SetCountOnly(true)
+     * first reports Entries, and so the memory the index lists would need, in O(N)
+     * memory; this is a cheap way to screen input for quadratic blowup.
+     * Return:  The statistics; O(number of breakpoints) to compute */
+    RangeMapStats Stats() const {
+        RangeMapStats R;
+        R.Breakpoints = Tab.size();
+        R.Entries = Off.empty() ? 0 : Off.back();
+        for (size_t x = 0; x < Tab.size(); ++x)
+            R.MaxActive = std::max(R.MaxActive, Off[x + 1] - Off[x]);
+        R.MeanActive = Tab.empty() ? 0.0 : double(R.Entries) / Tab.size();
+        R.TabBytes = Tab.capacity() * sizeof(T);
+        R.IndexBytes = Off.capacity() * sizeof(size_t) + Idx.capacity() * sizeof(I);
+        R.LayoutBytes = (Eyt.capacity() + SKey.capacity()) * sizeof(T) + (ESpan.capacity() + SSpan.capacity()) * sizeof(Span);
+        R.TotalBytes = R.TabBytes + R.IndexBytes + R.LayoutBytes + Opens.capacity() * sizeof(I) + OPos.capacity() * sizeof(size_t);
+        R.BuildAllocs = BuildAllocs;
+        return R;
     }
 
     /* Given a query point, returns all intervals containing the point
      * p:       The query point
-     * Return:  A vector of all intervals containing the point */
-    const std::vector<size_t>& Query(const T& p) const {
-        auto It = std::lower_bound(Tab.begin(), Tab.end(), p);
-        // IList[x] contains the result, where x is the largest index such that Tab[x] <= p
-        return (It != Tab.end()) ? IList[(It - Tab.begin()) - (*It > p)] : Empty;
+     * Return:  A view of all intervals containing the point */
+    BasicIndexView<I> Query(const T& p) const {
+        if (CountOnly)
+            return BasicIndexView<I>();
+        const Span R = Find(p);
+        return BasicIndexView<I>(Idx.data() + R.first, Idx.data() + R.second);
     }
+
+    /* Given a query point, counts the intervals containing the point
+     * p:       The query point
+     * Return:  The number of intervals containing the point */
+    size_t Count(const T& p) const {
+        const Span R = Find(p);
+        return R.second - R.first;
+    }
+
+    /* Finds all intervals overlapping the window [lo, hi), each reported once.
+     * These are the intervals containing lo followed by those starting inside
+     * the window, so the cost is O(log N + k) for k results and the call does
+     * not allocate. The sorted breakpoint table is searched whatever the layout.
+     * Requires SetWindowQueries(true) before Build: calling it on another built map
+     * asserts, and returns 0 if asserts are disabled. Count-only maps return 0.
+     * lo, hi:  The window
+     * RIdx:    Output; indices of the intervals containing lo in increasing order,
+     *          then those starting in (lo, hi) in order of starting value
+     * Cap:     Capacity of RIdx
+     * Return:  Number of intervals overlapping the window. If larger than Cap, RIdx
+     *          does not hold the full result; call again with a buffer of this size */
+    size_t QueryRange(const T& lo, const T& hi, I* RIdx, const size_t Cap) const {
+        // OPos is only filled when the last Build kept window queries
+        assert((!OPos.empty() || CountOnly || Tab.empty()) && "QueryRange requires SetWindowQueries(true) before Build");
+        if (OPos.empty() || !(lo < hi))
+            return 0;
+        const size_t x = Slot(lo);
+        const size_t Tot = Append(x, 0, RIdx, Cap);
+        // Intervals opening at breakpoints in (lo, hi)
+        const size_t b = (x == NONE) ? 0 : (x + 1);
+        const size_t e = std::lower_bound(Tab.begin() + b, Tab.end(), hi) - Tab.begin();
+        const size_t n = OPos[e] - OPos[b];
+        if (Tot + n <= Cap)
+            std::copy(Opens.data() + OPos[b], Opens.data() + OPos[e], RIdx + Tot);
+        return Tot + n;
+    }
+
+    /* Finds all intervals containing each of many query points. The searches for
+     * groups of points are interleaved to hide memory latency and the call does
+     * not allocate. The sorted breakpoint table is searched whatever the layout.
+     * P:       Array of query points
+     * M:       Number of query points
+     * ROff:    Output; M + 1 offsets so the result for P[i] is RIdx[ROff[i], ROff[i + 1])
+     * RIdx:    Output; concatenated results for all points
+     * Cap:     Capacity of RIdx
+     * Return:  Total number of indices in the results. If larger than Cap, RIdx only
+     *          holds the results that fit; call again with a buffer of this size */
+    size_t QueryBatch(const T* P, const size_t M, size_t* ROff, I* RIdx, const size_t Cap) const {
+        size_t X[BATCH];
+        size_t Tot = 0;
+        ROff[0] = 0;
+        for (size_t b = 0; b < M; b += BATCH) {
+            const size_t G = std::min(BATCH, M - b);
+            SlotBatch(P + b, G, X);
+            for (size_t j = 0; j < G; ++j) {
+                if (X[j] != NONE)
+                    RM_PREFETCH(Off.data() + X[j]);
+            }
+            for (size_t j = 0; j < G; ++j) {
+                Tot = Append(X[j], Tot, RIdx, Cap);
+                ROff[b + j + 1] = Tot;
+            }
+        }
+        return Tot;
+    }
+
+    /* Finds all intervals containing each of many sorted query points by walking
+     * the breakpoints alongside the points, galloping over gaps between them. This
+     * costs O(M log(N / M) + M) for M points instead of O(M log N). Output is as for
+     * QueryBatch and the sorted breakpoint table is used whatever the layout.
+     * P:       Array of query points in nondecreasing order
+     * M:       Number of query points
+     * ROff:    Output; M + 1 offsets so the result for P[i] is RIdx[ROff[i], ROff[i + 1])
+     * RIdx:    Output; concatenated results for all points
+     * Cap:     Capacity of RIdx
+     * Return:  Total number of indices in the results. If larger than Cap, RIdx only
+     *          holds the results that fit; call again with a buffer of this size */
+    size_t QuerySorted(const T* P, const size_t M, size_t* ROff, I* RIdx, const size_t Cap) const {
+        size_t Tot = 0;
+        size_t x = NONE;    // Slot of the previous point
+        ROff[0] = 0;
+        for (size_t i = 0; i < M; ++i) {
+            assert(i == 0 || !(P[i] < P[i - 1]));
+            // Gallop without a limit so the walk over all points stays O(M log(N / M))
+            x = SlotNear(P[i], x, std::numeric_limits<size_t>::max());
+            Tot = Append(x, Tot, RIdx, Cap);
+            ROff[i + 1] = Tot;
+        }
+        return Tot;
+    }
+
+    /* Answers a stream of queries that tend to be near one another by remembering
+     * the slot of the previous query and galloping outward from it. A query d
+     * breakpoints away from the previous one costs O(log d); large jumps fall back
+     * to a binary search. The cursor is invalidated when its map is rebuilt. */
+    class Cursor {
+        const RangeMap* Map;    // The map being queried
+        size_t X = NONE;        // Slot of the previous query
+
+    public:
+        explicit Cursor(const RangeMap& M) : Map(&M) { }
+
+        /* Given a query point, returns all intervals containing the point
+         * p:       The query point
+         * Return:  A view of all intervals containing the point */
+        BasicIndexView<I> Query(const T& p) {
+            X = Map->SlotNear(p, X, GALLOP);
+            return Map->View(X);
+        }
+    };
 };
 
 #endif
\ No newline at end of file
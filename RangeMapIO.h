@@ -0,0 +1,563 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   RangeMapIO.h
+// Desc:   On-disk format for prebuilt RangeMaps, queried in place with mmap
+//================================================================================
+#ifndef RANGE_MAP_IO_H
+#define RANGE_MAP_IO_H
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "RangeMap.h"
+
+/* File layout, all in the byte order of the machine that wrote it:
+ *   FileHeader                  64 bytes
+ *   Tab      NTab keys          padded to a multiple of 64 bytes
+ *   Off      NOff offsets       padded to a multiple of 64 bytes
+ *   Idx      NIdx indices       padded to a multiple of 64 bytes
+ *   Checksum of all the above   8 bytes
+ * Every section starts 64-byte aligned so the arrays can be used directly from
+ * the mapped file. A file only opens on a machine with the same byte order,
+ * key type, index width and offset width. */
+namespace RMImpl {
+    constexpr uint32_t FILE_VERSION = 2;       // 2 added OffSize
+    constexpr uint32_t FILE_ENDIAN = 0x01020304;    // Reads as 0x04030201 with the other byte order
+    constexpr size_t FILE_ALIGN = 64;
+
+    // Flags stored in FileHeader
+    constexpr uint32_t FILE_COUNT_ONLY = 1;         // Idx is empty; only Count may be used
+
+    struct FileHeader {
+        char Magic[8];          // "RANGEMAP"
+        uint32_t Endian;        // FILE_ENDIAN
+        uint32_t Version;       // FILE_VERSION
+        uint32_t KeySize;       // sizeof(T)
+        uint32_t KeyKind;       // See KeyKind()
+        uint32_t IdxSize;       // sizeof(I), the width of stored interval indices
+        uint32_t OffSize;       // sizeof(size_t), the width of stored offsets
+        uint32_t Flags;
+        uint32_t Reserved;
+        uint64_t NTab;          // Number of breakpoints
+        uint64_t NOff;          // Number of offsets; NTab + 1
+        uint64_t NIdx;          // Number of stored interval indices
+    };
+    static_assert(sizeof(FileHeader) == FILE_ALIGN, "FileHeader must fill one aligned block");
+
+    // Distinguishes key types of the same size: 1 unsigned, 2 signed, 3 floating point, 0 other
+    template <typename T>
+    constexpr uint32_t KeyKind() {
+        return std::is_floating_point<T>::value ? 3 : std::is_integral<T>::value ? (std::is_signed<T>::value ? 2 : 1) : 0;
+    }
+
+    // Header for a file holding a map with the given sizes
+    template <typename T, typename I>
+    FileHeader MakeHeader(uint32_t Flags, size_t NTab, size_t NOff, size_t NIdx) {
+        FileHeader H = {};
+        std::memcpy(H.Magic, "RANGEMAP", 8);
+        H.Endian = FILE_ENDIAN;
+        H.Version = FILE_VERSION;
+        H.KeySize = sizeof(T);
+        H.KeyKind = KeyKind<T>();
+        H.IdxSize = sizeof(I);
+        H.OffSize = sizeof(size_t);
+        H.Flags = Flags;
+        H.NTab = NTab;
+        H.NOff = NOff;
+        H.NIdx = NIdx;
+        return H;
+    }
+
+    // Bytes of padding following a section of n bytes
+    inline size_t PadBytes(size_t n) {
+        return (FILE_ALIGN - n % FILE_ALIGN) % FILE_ALIGN;
+    }
+
+    /* Running checksum over whole 64-bit words using four independent lanes so
+     * it proceeds at close to memory bandwidth. Not cryptographic; it catches
+     * truncation, torn writes and bit rot. */
+    class Checksum {
+        uint64_t H[4] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x85EBCA77C2B2AE63ull};
+        size_t Lane = 0;    // Lane receiving the next word
+
+        static uint64_t Round(uint64_t h, uint64_t w) {
+            h += w * 0xC2B2AE3D27D4EB4Full;
+            h = (h << 31) | (h >> 33);
+            return h * 0x9E3779B97F4A7C15ull;
+        }
+
+    public:
+        /* Adds data to the checksum
+         * P:   The data; a multiple of 8 bytes long
+         * n:   Number of bytes */
+        void Add(const void* P, size_t n) {
+            assert(n % 8 == 0);
+            const unsigned char* B = static_cast<const unsigned char*>(P);
+            for (size_t i = 0; i < n; i += 8) {
+                uint64_t w;
+                std::memcpy(&w, B + i, 8);
+                H[Lane] = Round(H[Lane], w);
+                Lane = (Lane + 1) & 3;
+            }
+        }
+
+        // The checksum of all data added so far
+        uint64_t Value() const {
+            uint64_t h = 0;
+            for (uint64_t v : H)
+                h = Round(h ^ v, v);
+            return h;
+        }
+    };
+}
+
+/* A RangeMap stored in a file by Save and mapped into memory by Open. Opening
+ * does not parse or copy anything: queries read the breakpoint table and index
+ * lists directly from the mapped file, and pages are loaded on first use. The
+ * sorted breakpoint table is searched whatever layout the saved map used.
+ * Requires POSIX mmap. */
+template <typename T, typename I>
+class MappedRangeMap {
+    const T* Tab = nullptr;         // Breakpoint table in the mapping
+    const size_t* Off = nullptr;    // Offsets into Idx in the mapping
+    const I* Idx = nullptr;         // Interval indices in the mapping
+    size_t NTab = 0;                // Number of breakpoints
+    bool CountOnly = false;         // Idx is empty
+    void* Map = nullptr;            // The mapping
+    size_t MapSize = 0;             // Length of the mapping
+
+    // Writes a section followed by its padding and adds both to the checksum
+    static void WriteSection(std::ostream& Out, RMImpl::Checksum& C, const void* P, size_t n) {
+        static const char Zero[RMImpl::FILE_ALIGN] = {};
+        Out.write(static_cast<const char*>(P), n);
+        const size_t Pad = RMImpl::PadBytes(n);
+        Out.write(Zero, Pad);
+        // Checksum the bytes as written; the tail of the section and its padding form whole words
+        const size_t Whole = n - n % 8;
+        char Last[RMImpl::FILE_ALIGN + 8] = {};
+        if (Whole != n)
+            std::memcpy(Last, static_cast<const char*>(P) + Whole, n - Whole);
+        C.Add(P, Whole);
+        C.Add(Last, n + Pad - Whole);
+    }
+
+public:
+    MappedRangeMap() = default;
+    MappedRangeMap(const MappedRangeMap&) = delete;
+    MappedRangeMap& operator=(const MappedRangeMap&) = delete;
+
+    ~MappedRangeMap() {
+        Close();
+    }
+
+    /* Writes a map to a stream in a single sequential pass
+     * rm:      The map to save
+     * Out:     The stream to write to; should be opened in binary mode
+     * Return:  True if every write succeeded */
+    template <typename P>
+    static bool Save(const RangeMap<T, I, P>& rm, std::ostream& Out) {
+        const RMImpl::FileHeader H = RMImpl::MakeHeader<T, I>(rm.CountOnly ? RMImpl::FILE_COUNT_ONLY : 0, rm.Tab.size(),
+                                                           rm.Off.size(), rm.Idx.size());
+        RMImpl::Checksum C;
+        WriteSection(Out, C, &H, sizeof(H));
+        WriteSection(Out, C, rm.Tab.data(), rm.Tab.size() * sizeof(T));
+        WriteSection(Out, C, rm.Off.data(), rm.Off.size() * sizeof(size_t));
+        WriteSection(Out, C, rm.Idx.data(), rm.Idx.size() * sizeof(I));
+        const uint64_t V = C.Value();
+        Out.write(reinterpret_cast<const char*>(&V), sizeof(V));
+        return bool(Out);
+    }
+
+    /* Writes a map to a file
+     * rm:      The map to save
+     * Path:    The file to create or replace
+     * Return:  True if the file was written completely */
+    template <typename P>
+    static bool Save(const RangeMap<T, I, P>& rm, const char* Path) {
+        std::ofstream Out(Path, std::ios::binary | std::ios::trunc);
+        return Save(rm, Out) && bool(Out.flush());
+    }
+
+    /* Maps a file written by Save. Fails if the file is truncated, was written for
+     * another byte order, key type, index width or offset width, or has a bad checksum.
+     * Path:    The file to open
+     * Verify:  Whether to check the checksum, which reads the whole file once
+     * Return:  True if the file was opened */
+    bool Open(const char* Path, bool Verify = true) {
+        Close();
+        const int fd = ::open(Path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat St;
+        void* M = MAP_FAILED;
+        if ((::fstat(fd, &St) == 0) && (size_t(St.st_size) >= sizeof(RMImpl::FileHeader) + sizeof(uint64_t)))
+            M = ::mmap(nullptr, St.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);    // The mapping stays valid
+        if (M == MAP_FAILED)
+            return false;
+        Map = M;
+        MapSize = St.st_size;
+        const char* B = static_cast<const char*>(M);
+        const RMImpl::FileHeader& H = *reinterpret_cast<const RMImpl::FileHeader*>(B);
+        // Sections and their sizes must agree with the length of the file
+        const size_t LTab = H.NTab * sizeof(T), LOff = H.NOff * sizeof(size_t), LIdx = H.NIdx * sizeof(I);
+        const size_t PTab = sizeof(H), POff = PTab + LTab + RMImpl::PadBytes(LTab), PIdx = POff + LOff + RMImpl::PadBytes(LOff);
+        const size_t PEnd = PIdx + LIdx + RMImpl::PadBytes(LIdx);
+        bool Ok = (std::memcmp(H.Magic, "RANGEMAP", 8) == 0) && (H.Endian == RMImpl::FILE_ENDIAN) &&
+                  (H.Version == RMImpl::FILE_VERSION) && (H.KeySize == sizeof(T)) && (H.KeyKind == RMImpl::KeyKind<T>()) &&
+                  (H.IdxSize == sizeof(I)) && (H.OffSize == sizeof(size_t)) && (H.NTab < MapSize / sizeof(T)) && (H.NOff == H.NTab + (H.NTab > 0)) &&
+                  (H.NIdx < MapSize / sizeof(I)) && (PEnd + sizeof(uint64_t) == MapSize);
+        if (Ok && Verify) {
+            ::madvise(M, MapSize, MADV_SEQUENTIAL);
+            RMImpl::Checksum C;
+            C.Add(B, PEnd);
+            uint64_t V;
+            std::memcpy(&V, B + PEnd, sizeof(V));
+            Ok = (C.Value() == V);
+            ::madvise(M, MapSize, MADV_NORMAL);
+        }
+        if (Ok && H.NTab > 0) {
+            const size_t* O = reinterpret_cast<const size_t*>(B + POff);
+            Ok = (O[0] == 0) && ((H.Flags & RMImpl::FILE_COUNT_ONLY) || O[H.NTab] == H.NIdx);
+        }
+        if (!Ok) {
+            Close();
+            return false;
+        }
+        Tab = reinterpret_cast<const T*>(B + PTab);
+        Off = reinterpret_cast<const size_t*>(B + POff);
+        Idx = reinterpret_cast<const I*>(B + PIdx);
+        NTab = H.NTab;
+        CountOnly = (H.Flags & RMImpl::FILE_COUNT_ONLY) != 0;
+        return true;
+    }
+
+    // Unmaps the file; views returned by Query are invalidated
+    void Close() {
+        if (Map != nullptr)
+            ::munmap(Map, MapSize);
+        Map = nullptr;
+        MapSize = 0;
+        Tab = nullptr;
+        Off = nullptr;
+        Idx = nullptr;
+        NTab = 0;
+        CountOnly = false;
+    }
+
+    /* Given a query point, returns all intervals containing the point
+     * p:       The query point
+     * Return:  A view of all intervals containing the point; valid until Close. Empty
+     *          if the map was saved count-only */
+    BasicIndexView<I> Query(const T& p) const {
+        const size_t x = RMImpl::FindSlot(Tab, NTab, p);
+        if ((x >= NTab) || CountOnly)
+            return BasicIndexView<I>();
+        return BasicIndexView<I>(Idx + Off[x], Idx + Off[x + 1]);
+    }
+
+    /* Given a query point, counts the intervals containing the point
+     * p:       The query point
+     * Return:  The number of intervals containing the point */
+    size_t Count(const T& p) const {
+        const size_t x = RMImpl::FindSlot(Tab, NTab, p);
+        return (x >= NTab) ? 0 : (Off[x + 1] - Off[x]);
+    }
+};
+
+/* Builds a map file in the format read by MappedRangeMap from a stream of
+ * intervals too large to hold in memory. Interval endpoints are sorted with an
+ * external merge sort: they are buffered up to the memory budget, spilled to
+ * temporary files as sorted runs, and the runs are merged while sweeping the
+ * breakpoints. Breakpoints, offsets and index lists are streamed to temporary
+ * files and copied into the output once their sizes are known, so the output is
+ * written sequentially and is identical to saving a RangeMap built from the same
+ * intervals.
+ *
+ * Peak memory is about the budget plus the largest active set: the intervals
+ * containing any one point must still fit in memory. At most FANIN runs are
+ * merged at once, each read in blocks carved from the budget; once FANIN runs of
+ * the same size class build up they are merged into one, so the number of open
+ * temporary files grows only logarithmically with the input. Temporary files
+ * come from std::tmpfile and need about twice the input size, times the number
+ * of merge passes, plus the size of the output. */
+template <typename T, typename I = size_t>
+class RangeMapFileBuilder {
+    // An interval endpoint; ordered by value then by interval index like ArgSort
+    struct Event {
+        T Key;
+        size_t Id;
+        bool operator<(const Event& o) const { return (Key < o.Key) || (!(o.Key < Key) && (Id < o.Id)); }
+    };
+
+    // Reads a sorted run back from a temporary file one block at a time
+    struct RunReader {
+        std::FILE* F;
+        size_t Left;        // Events not yet read from the file
+        Event* Block;       // Storage for Cap events
+        size_t Cap;
+        size_t Size = 0;    // Events read but not yet consumed
+        size_t Pos = 0;     // Next event in Block
+
+        // Reads the next block; returns false if the read fails
+        bool Fill() {
+            Size = std::min(Cap, Left);
+            Pos = 0;
+            Left -= Size;
+            if (std::fread(Block, sizeof(Event), Size, F) != Size) {
+                Size = 0;
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // The sorted events of one kind; first buffered in memory and spilled as runs
+    struct EventSort {
+        static constexpr size_t FANIN = 64;     // Most runs merged at once
+
+        // A spilled run; merging FANIN runs of one level gives a run of the next level
+        struct Run {
+            std::FILE* F;
+            size_t Size;        // Number of events
+            unsigned Level;
+        };
+
+        size_t Cap = 1;                 // Events buffered before spilling
+        std::vector<Event> Buf;         // Events not yet spilled; holds the read blocks while merging
+        std::vector<Run> Runs;          // Spilled runs; levels never increase along the list
+        std::vector<RunReader> Readers; // Runs being merged
+        std::vector<size_t> Heap;       // Min-heap of readers by their next event
+        bool Ok = true;
+
+        ~EventSort() {
+            for (const Run& r : Runs)
+                std::fclose(r.F);
+        }
+
+        // Sorts the buffer and writes it to a new run, merging runs if FANIN share a level
+        void Spill() {
+            if (Buf.empty())
+                return;
+            std::sort(Buf.begin(), Buf.end());
+            std::FILE* F = std::tmpfile();
+            Ok = Ok && (F != nullptr) && (std::fwrite(Buf.data(), sizeof(Event), Buf.size(), F) == Buf.size());
+            if (F != nullptr)
+                Runs.push_back(Run{F, Buf.size(), 0});
+            Buf.clear();
+            while ((Runs.size() >= FANIN) && (Runs[Runs.size() - FANIN].Level == Runs.back().Level))
+                Merge(Runs.size() - FANIN);
+        }
+
+        // Whether reader i orders after reader j in the heap
+        bool After(size_t i, size_t j) const {
+            return Readers[j].Block[Readers[j].Pos] < Readers[i].Block[Readers[i].Pos];
+        }
+
+        /* Starts merging runs b onward, splitting the buffer into one read block per run
+         * b:   First run to merge */
+        void Begin(size_t b) {
+            Readers.clear();
+            Heap.clear();
+            const size_t k = Runs.size() - b;
+            if (k == 0)
+                return;
+            Buf.resize(std::max(Cap, k));
+            const size_t Per = Buf.size() / k;
+            for (size_t r = 0; r < k; ++r) {
+                std::rewind(Runs[b + r].F);
+                Readers.push_back(RunReader{Runs[b + r].F, Runs[b + r].Size, Buf.data() + r * Per, Per});
+                Ok = Readers[r].Fill() && Ok;
+                if (Readers[r].Size > 0)
+                    Heap.push_back(r);
+            }
+            std::make_heap(Heap.begin(), Heap.end(), [this](size_t i, size_t j) { return After(i, j); });
+        }
+
+        /* Merges runs b onward into a single run one level above the highest of them
+         * b:   First run to merge */
+        void Merge(size_t b) {
+            std::FILE* F = std::tmpfile();
+            Ok = Ok && (F != nullptr);
+            const unsigned Level = Runs[b].Level + 1;
+            size_t n = 0;
+            for (Begin(b); !Empty(); Pop()) {
+                Ok = Ok && (std::fwrite(&Top(), sizeof(Event), 1, F) == 1);
+                ++n;
+            }
+            for (size_t r = b; r < Runs.size(); ++r)
+                std::fclose(Runs[r].F);
+            Runs.resize(b);
+            if (F != nullptr)
+                Runs.push_back(Run{F, n, Level});
+            Buf.clear();
+        }
+
+        // Spills the buffer, merges down to FANIN runs and starts merging them
+        void Start() {
+            Spill();
+            while (Runs.size() > FANIN)
+                Merge(Runs.size() - FANIN);
+            Begin(0);
+        }
+
+        // The next event in sorted order; requires !Empty()
+        const Event& Top() const {
+            const RunReader& R = Readers[Heap.front()];
+            return R.Block[R.Pos];
+        }
+
+        bool Empty() const {
+            return Heap.empty();
+        }
+
+        // Moves past the next event
+        void Pop() {
+            auto Cmp = [this](size_t i, size_t j) { return After(i, j); };
+            std::pop_heap(Heap.begin(), Heap.end(), Cmp);
+            RunReader& R = Readers[Heap.back()];
+            if ((++R.Pos == R.Size) && (R.Left > 0))
+                Ok = R.Fill() && Ok;
+            if (R.Pos < R.Size)
+                std::push_heap(Heap.begin(), Heap.end(), Cmp);
+            else
+                Heap.pop_back();
+        }
+    };
+
+    std::string Path;       // Output file
+    size_t Budget;          // Bytes of memory for buffered events
+    size_t N = 0;           // Number of intervals added
+    EventSort Starts, Ends;
+
+    // Number of events of each kind buffered before spilling a run
+    size_t Capacity() const {
+        return std::max<size_t>(1, Budget / (2 * sizeof(Event)));
+    }
+
+    /* Copies a temporary file into the output followed by its padding, adding both to the checksum
+     * Out:     The output
+     * C:       The checksum
+     * F:       The temporary file; rewound first
+     * n:       Number of bytes in F
+     * Return:  True if every read and write succeeded */
+    static bool CopySection(std::ostream& Out, RMImpl::Checksum& C, std::FILE* F, size_t n) {
+        constexpr size_t CHUNK = size_t(1) << 16;   // A multiple of FILE_ALIGN
+        std::vector<char> B(CHUNK + RMImpl::FILE_ALIGN);
+        std::rewind(F);
+        for (size_t Done = 0; Done < n; ) {
+            const size_t k = std::min(CHUNK, n - Done);
+            if (std::fread(B.data(), 1, k, F) != k)
+                return false;
+            Done += k;
+            // Only the last chunk can end off the alignment, so it carries the section's padding
+            const size_t Pad = RMImpl::PadBytes(k);
+            std::fill(B.begin() + k, B.begin() + k + Pad, 0);
+            Out.write(B.data(), k + Pad);
+            C.Add(B.data(), k + Pad);
+        }
+        return bool(Out);
+    }
+
+public:
+    /* Path:    The map file to write
+     * Budget:  Bytes of memory to use for sorting, not counting the active sets */
+    explicit RangeMapFileBuilder(const std::string& Path, size_t Budget = size_t(1) << 28) : Path(Path), Budget(Budget) {
+        Starts.Cap = Ends.Cap = Capacity();
+        Starts.Buf.reserve(Capacity());
+        Ends.Buf.reserve(Capacity());
+    }
+
+    RangeMapFileBuilder(const RangeMapFileBuilder&) = delete;
+    RangeMapFileBuilder& operator=(const RangeMapFileBuilder&) = delete;
+
+    /* Adds the interval [a, b); its index is the number of intervals added before it
+     * a:       Interval starting value
+     * b:       Interval closing value
+     * Return:  False if I cannot hold the index; the interval is then not added */
+    bool Add(const T& a, const T& b) {
+        if (N > std::numeric_limits<I>::max())
+            return false;   // The index would wrap
+        if (a < b) {    // [a, b) with b <= a is empty
+            // -0 is stored as 0, as RangeMap::Build stores it
+            Starts.Buf.push_back(Event{RMImpl::PositiveZero(a), N});
+            Ends.Buf.push_back(Event{RMImpl::PositiveZero(b), N});
+            if (Starts.Buf.size() >= Capacity()) {
+                Starts.Spill();
+                Ends.Spill();
+            }
+        }
+        ++N;
+        return true;
+    }
+
+    /* Merges the runs, sweeps the breakpoints and writes the map file. The
+     * builder cannot be used afterwards.
+     * Return:  True if the file was written completely */
+    bool Finish() {
+        constexpr T MINV = std::numeric_limits<T>::has_infinity ? NEG_INFTY : std::numeric_limits<T>::min();
+        constexpr T MAXV = std::numeric_limits<T>::has_infinity ? POS_INFTY : std::numeric_limits<T>::max();
+        Starts.Start();
+        Ends.Start();
+        std::FILE* FTab = std::tmpfile();
+        std::FILE* FOff = std::tmpfile();
+        std::FILE* FIdx = std::tmpfile();
+        bool Ok = Starts.Ok && Ends.Ok && FTab && FOff && FIdx;
+        // Sweep the merged endpoints like RMImpl::Sweep, streaming out each active set
+        std::vector<I> A, A2;               // Active set and next active set
+        std::vector<size_t> O, C;           // Opening and closing
+        size_t NTab = 0, NIdx = 0;
+        auto Emit = [&](const T& v) {
+            A2.resize(A.size() + O.size());
+            A2.resize(RMImpl::MergeDelta(A.data(), A.data() + A.size(), O.data(), O.data() + O.size(),
+                                         C.data(), C.data() + C.size(), A2.data()) - A2.data());
+            A.swap(A2);
+            if (NTab == 0)
+                Ok = Ok && (std::fwrite(&NIdx, sizeof(size_t), 1, FOff) == 1);
+            NIdx += A.size();
+            ++NTab;
+            Ok = Ok && (std::fwrite(&v, sizeof(T), 1, FTab) == 1) && (std::fwrite(&NIdx, sizeof(size_t), 1, FOff) == 1) &&
+                 (A.empty() || (std::fwrite(A.data(), sizeof(I), A.size(), FIdx) == A.size()));
+            O.clear();
+            C.clear();
+        };
+        if (Ok && N > 0) {     // RangeMap leaves the map empty when there are no intervals
+            if (Starts.Empty() || Starts.Top().Key > MINV)
+                Emit(MINV);
+            T Last = MINV;  // Last breakpoint
+            while (!Starts.Empty() || !Ends.Empty()) {
+                const T v = (Starts.Empty() || (!Ends.Empty() && !(Starts.Top().Key < Ends.Top().Key))) ? Ends.Top().Key : Starts.Top().Key;
+                for (; !Starts.Empty() && (Starts.Top().Key == v); Starts.Pop())
+                    O.push_back(Starts.Top().Id);
+                for (; !Ends.Empty() && (Ends.Top().Key == v); Ends.Pop())
+                    C.push_back(Ends.Top().Id);
+                Last = v;
+                Emit(v);
+            }
+            if (Last < MAXV)
+                Emit(MAXV);
+            Ok = Ok && Starts.Ok && Ends.Ok;
+        }
+        // Assemble the output now that the section sizes are known
+        std::ofstream Out(Path, std::ios::binary | std::ios::trunc);
+        RMImpl::Checksum Sum;
+        const RMImpl::FileHeader H = RMImpl::MakeHeader<T, I>(0, NTab, NTab + (NTab > 0), NIdx);
+        Out.write(reinterpret_cast<const char*>(&H), sizeof(H));
+        Sum.Add(&H, sizeof(H));
+        Ok = Ok && CopySection(Out, Sum, FTab, NTab * sizeof(T)) && CopySection(Out, Sum, FOff, H.NOff * sizeof(size_t)) &&
+             CopySection(Out, Sum, FIdx, NIdx * sizeof(I));
+        const uint64_t V = Sum.Value();
+        Out.write(reinterpret_cast<const char*>(&V), sizeof(V));
+        for (std::FILE* F : {FTab, FOff, FIdx}) {
+            if (F != nullptr)
+                std::fclose(F);
+        }
+        return Ok && bool(Out.flush());
+    }
+};
+
+#endif
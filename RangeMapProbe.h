@@ -0,0 +1,131 @@
+//================================================================================
+// Author: Nicholas T. Smith
+// File:   RangeMapProbe.h
+// Desc:   Instrumentation policy recording RangeMap query and build metrics
+//================================================================================
+#ifndef RANGE_MAP_PROBE_H
+#define RANGE_MAP_PROBE_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "RangeMap.h"
+
+// Totals recorded by a CountingProbe
+struct ProbeCounts {
+    static constexpr size_t DEPTHS = 64;    // Searches of more steps are counted in the last bucket
+    static constexpr size_t PHASES = 3;     // Number of BuildPhase values
+
+    uint64_t Queries = 0;               // Calls to Query and Count
+    uint64_t Results = 0;               // Intervals found by those calls
+    uint64_t Depth[DEPTHS] = {};        // Number of searches taking each number of steps
+    uint64_t Builds = 0;                // Calls to Build with at least one interval
+    uint64_t PhaseNs[PHASES] = {};      // Total time spent in each BuildPhase
+};
+
+/* Instrumentation policy for RangeMap that counts queries and their results, keeps
+ * a histogram of search depth (levels for the Eytzinger and S-tree layouts, binary
+ * search halvings otherwise) and times each phase of Build.
+ *
+ * Each thread records into its own counters, so hooks on the query path are a few
+ * uncontended loads and stores. Counts are shared by every map using the same
+ * probe type; give maps that should be counted separately their own Tag:
+ *   struct Orders;
+ *   RangeMap<int, size_t, CountingProbe<Orders> > rm;
+ *   ProbeCounts c = CountingProbe<Orders>::Read(); */
+template <typename Tag = void>
+class CountingProbe {
+    // One thread's counters. Only that thread writes them, so plain loads and stores
+    // of relaxed atomics suffice and other threads can read them at any time.
+    struct Shard {
+        std::atomic<uint64_t> Queries{0}, Results{0}, Builds{0};
+        std::atomic<uint64_t> Depth[ProbeCounts::DEPTHS] = {};
+        std::atomic<uint64_t> PhaseNs[ProbeCounts::PHASES] = {};
+    };
+
+    // Shards of running threads and the totals of threads that have exited
+    struct Registry {
+        std::mutex Mtx;
+        std::vector<const Shard*> Live;
+        ProbeCounts Exited;
+    };
+
+    // Registers the calling thread's shard and folds it into the totals on exit
+    struct Local {
+        Shard S;
+
+        Local() {
+            std::lock_guard<std::mutex> Lock(Reg().Mtx);
+            Reg().Live.push_back(&S);
+        }
+
+        ~Local() {
+            std::lock_guard<std::mutex> Lock(Reg().Mtx);
+            Add(Reg().Exited, S);
+            Reg().Live.erase(std::find(Reg().Live.begin(), Reg().Live.end(), &S));
+        }
+    };
+
+    static Registry& Reg() {
+        static Registry R;
+        return R;
+    }
+
+    static Shard& Mine() {
+        thread_local Local L;
+        return L.S;
+    }
+
+    static void Bump(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    static void Add(ProbeCounts& C, const Shard& S) {
+        C.Queries += S.Queries.load(std::memory_order_relaxed);
+        C.Results += S.Results.load(std::memory_order_relaxed);
+        C.Builds += S.Builds.load(std::memory_order_relaxed);
+        for (size_t d = 0; d < ProbeCounts::DEPTHS; ++d)
+            C.Depth[d] += S.Depth[d].load(std::memory_order_relaxed);
+        for (size_t h = 0; h < ProbeCounts::PHASES; ++h)
+            C.PhaseNs[h] += S.PhaseNs[h].load(std::memory_order_relaxed);
+    }
+
+public:
+    static constexpr bool Enabled = true;
+
+    static void Query(unsigned d, size_t k) {
+        Shard& S = Mine();
+        Bump(S.Queries, 1);
+        Bump(S.Results, k);
+        Bump(S.Depth[std::min<size_t>(d, ProbeCounts::DEPTHS - 1)], 1);
+    }
+
+    static uint64_t Clock() {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static uint64_t Phase(BuildPhase ph, uint64_t t) {
+        const uint64_t Now = Clock();
+        Shard& S = Mine();
+        Bump(S.PhaseNs[size_t(ph)], Now - t);
+        if (ph == BuildPhase::ArgSort)
+            Bump(S.Builds, 1);
+        return Now;
+    }
+
+    /* Sums the counters of every thread. Counts still being recorded by other
+     * threads may or may not be included.
+     * Return:  The totals */
+    static ProbeCounts Read() {
+        std::lock_guard<std::mutex> Lock(Reg().Mtx);
+        ProbeCounts C = Reg().Exited;
+        for (const Shard* s : Reg().Live)
+            Add(C, *s);
+        return C;
+    }
+};
+
+#endif